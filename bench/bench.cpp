@@ -0,0 +1,399 @@
+// Microbenchmarks for the tracing kernels. Every benchmark works on inputs
+// generated up front from a fixed seed, runs a warm-up, then grows its iteration
+// count until one run takes at least --min_time and reports the median of
+// --repeats runs. Results can be written as JSON or CSV and compared between
+// commits with bench/compare.py.
+//
+//   ./build/path_tracer_bench [--filter substr] [--min_time 0.2] [--repeats 5]
+//                             [--json out.json] [--csv out.csv]
+#include "path_tracer.h"
+#include "cornell.h"
+#include "rectangle.h"
+#include "sphere.h"
+#include "rotated_box.h"
+#include "instance.h"
+#include "flat_rects.h"
+#include "bvh.h"
+#include "static_scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kSeed = 12345;
+constexpr size_t kInputs = 4096;  // rays/points per benchmark, cycled through
+
+struct BenchResult {
+    std::string name;
+    uint64_t ops = 0;          // operations in the timed run
+    double ns_per_op = 0.0;    // median over the repeats
+    double rays_per_op = 0.0;  // rays traced per operation (0 = not a ray kernel)
+    double mrays_per_s = 0.0;
+};
+
+// Body: runs `n` operations and returns something derived from the results, so
+// the compiler cannot drop the work. Rays per op may depend on the run (paths).
+struct Benchmark {
+    std::string name;
+    std::function<uint64_t(uint64_t n)> body;
+    double rays_per_op = 1.0;
+    bool count_bvh_rays = false;  // use the BVH counters instead of rays_per_op
+};
+
+volatile uint64_t g_sink = 0;
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+BenchResult run(const Benchmark& b, double min_time, int repeats) {
+    // Warm-up: caches, branch predictors, CPU clocks
+    g_sink = g_sink + b.body(1024);
+
+    uint64_t n = 1024;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        g_sink = g_sink + b.body(n);
+        double t = seconds_since(start);
+        if (t >= min_time || n >= (uint64_t(1) << 40)) break;
+        n = t > 0.0 ? static_cast<uint64_t>(n * std::min(10.0, 1.2 * min_time / t)) + 1 : n * 10;
+    }
+
+    std::vector<double> ns;
+    std::vector<double> rays;
+    for (int r = 0; r < repeats; ++r) {
+        uint64_t rays_before = BVH::traversal_stats().rays;
+        auto start = std::chrono::steady_clock::now();
+        g_sink = g_sink + b.body(n);
+        double t = seconds_since(start);
+        ns.push_back(t * 1e9 / n);
+        rays.push_back(b.count_bvh_rays ? static_cast<double>(BVH::traversal_stats().rays - rays_before) / n : b.rays_per_op);
+    }
+    std::vector<double> sorted = ns;
+    std::sort(sorted.begin(), sorted.end());
+
+    BenchResult result;
+    result.name = b.name;
+    result.ops = n;
+    result.ns_per_op = sorted[sorted.size() / 2];
+    double rays_per_op = 0.0;
+    for (double v : rays) rays_per_op += v;
+    result.rays_per_op = rays_per_op / rays.size();
+    result.mrays_per_s = result.rays_per_op > 0.0 ? result.rays_per_op / result.ns_per_op * 1e3 : 0.0;
+    return result;
+}
+
+// Rays from random points inside the box toward random points of `target`
+// (slightly enlarged), so most but not all of them hit it.
+std::vector<Ray> rays_toward(const AABB& target, Sampler& sampler) {
+    std::vector<Ray> rays;
+    Vec3 pad(20, 20, 20);
+    Vec3 lo = target.minimum - pad, hi = target.maximum + pad;
+    for (size_t i = 0; i < kInputs; ++i) {
+        sampler.start_sample(static_cast<int>(i), 0, 0);
+        Vec3 origin(1 + 553 * sampler.next_1d(), 1 + 553 * sampler.next_1d(), 1 + 553 * sampler.next_1d());
+        Vec3 to(lo.x + (hi.x - lo.x) * sampler.next_1d(), lo.y + (hi.y - lo.y) * sampler.next_1d(),
+                lo.z + (hi.z - lo.z) * sampler.next_1d());
+        rays.push_back(Ray(origin, unit_vector(to - origin)));
+    }
+    return rays;
+}
+
+Benchmark hit_bench(const std::string& name, std::shared_ptr<const Hittable> object, Sampler& sampler) {
+    auto rays = std::make_shared<std::vector<Ray>>(rays_toward(object->bounding_box(), sampler));
+    return {name, [object, rays](uint64_t n) {
+        const Hittable& h = *object;
+        const std::vector<Ray>& rs = *rays;
+        HitRecord rec;
+        uint64_t hits = 0;
+        for (uint64_t i = 0; i < n; ++i)
+            hits += h.hit(rs[i % kInputs], 0, std::numeric_limits<Real>::infinity(), rec);
+        return hits;
+    }};
+}
+
+void write_json(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream out(path);
+    out << std::setprecision(6) << "{\n  \"simd\": \"" << simd_level_name(active_simd_level())
+        << "\",\n  \"real\": \"" << (sizeof(Real) == sizeof(float) ? "float" : "double") << "\",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"ops\": " << r.ops << ", \"ns_per_op\": " << r.ns_per_op
+            << ", \"rays_per_op\": " << r.rays_per_op << ", \"mrays_per_s\": " << r.mrays_per_s << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void write_csv(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream out(path);
+    out << std::setprecision(6) << "name,ops,ns_per_op,rays_per_op,mrays_per_s\n";
+    for (const BenchResult& r : results)
+        out << r.name << ',' << r.ops << ',' << r.ns_per_op << ',' << r.rays_per_op << ',' << r.mrays_per_s << '\n';
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string filter, json_path, csv_path;
+    double min_time = 0.2;
+    int repeats = 5;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if (strcmp(argv[i], "--min_time") == 0 && i + 1 < argc) min_time = atof(argv[++i]);
+        else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) repeats = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) json_path = argv[++i];
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) csv_path = argv[++i];
+        else if (strcmp(argv[i], "--simd") == 0 && i + 1 < argc) active_simd_level() = parse_simd_level(argv[++i]);
+    }
+#ifndef NDEBUG
+    std::cerr << "warning: benchmarks built without NDEBUG (use -DCMAKE_BUILD_TYPE=Release)\n";
+#endif
+
+    Sampler sampler(kSeed);
+    Scene scene;
+    build_cornell_box(scene);
+    scene.lights = build_light_list(scene.objects, scene.materials);
+    MaterialId white = 1;
+
+    // The same scene in the forms main.cpp can trace
+    auto list = std::make_shared<HittableList>(scene.objects);
+    auto flat = std::make_shared<HittableList>(flatten_rects(scene.objects));
+    auto bvh = std::make_shared<BVH>(*flat);
+    auto static_scene = std::make_shared<StaticScene>(*flat);
+    scene.accel = static_scene;
+
+    std::vector<Benchmark> benches;
+    benches.push_back(hit_bench("XYRect::hit", std::make_shared<XYRect>(0, 555, 0, 555, 555, white), sampler));
+    benches.push_back(hit_bench("XZRect::hit", std::make_shared<XZRect>(213, 343, 227, 332, 554, white), sampler));
+    benches.push_back(hit_bench("YZRect::hit", std::make_shared<YZRect>(0, 555, 0, 555, 0, white), sampler));
+    benches.push_back(hit_bench("Sphere::hit", std::make_shared<Sphere>(Vec3(278, 278, 278), 100, white), sampler));
+    benches.push_back(hit_bench("RotatedBox::hit",
+                                std::make_shared<RotatedBox>(Vec3(265, 0, 295), Vec3(430, 330, 460), white, -18), sampler));
+    {
+        // 4096 rotated and translated copies of one shared Box, under a BVH
+        auto shared_box = std::make_shared<Box>(Vec3(-10, -10, -10), Vec3(10, 10, 10), white);
+        HittableList copies;
+        for (int i = 0; i < 4096; ++i) {
+            sampler.start_sample(i, 2, 0);
+            Vec3 at(555 * sampler.next_1d(), 555 * sampler.next_1d(), 555 * sampler.next_1d());
+            copies.add(std::make_shared<Instance>(shared_box, Transform::translate(at) *
+                                                  Transform::rotate(random_unit_vector(sampler), 360 * sampler.next_1d())));
+        }
+        benches.push_back(hit_bench("BVH::hit (4096 box instances)", std::make_shared<BVH>(copies), sampler));
+    }
+    {
+        // 1600 small rects scattered in the box: flatten_rects() must leave the BVH
+        // something to cull (one set for all of them was 5x slower than --no_flat)
+        HittableList rects;
+        for (int i = 0; i < 1600; ++i) {
+            sampler.start_sample(i, 3, 0);
+            Real a = 20 + 500 * sampler.next_1d(), b = 20 + 500 * sampler.next_1d(), k = 20 + 510 * sampler.next_1d();
+            Real side = 5 + 20 * sampler.next_1d();
+            switch (i % 3) {
+                case 0: rects.add(std::make_shared<XYRect>(a, a + side, b, b + side, k, white)); break;
+                case 1: rects.add(std::make_shared<XZRect>(a, a + side, b, b + side, k, white)); break;
+                default: rects.add(std::make_shared<YZRect>(a, a + side, b, b + side, k, white)); break;
+            }
+        }
+        benches.push_back(hit_bench("StaticScene::hit (1600 rects)", std::make_shared<StaticScene>(rects), sampler));
+        benches.push_back(hit_bench("StaticScene::hit (1600 rects, flat)",
+                                    std::make_shared<StaticScene>(flatten_rects(rects)), sampler));
+    }
+    benches.push_back(hit_bench("HittableList::hit (cornell)", list, sampler));
+    benches.push_back(hit_bench("FlatRectSet+list::hit (cornell)", flat, sampler));
+    benches.push_back(hit_bench("BVH::hit (cornell)", bvh, sampler));
+    benches.push_back(hit_bench("StaticScene::hit (cornell)", static_scene, sampler));
+
+    // Shading points on the floor and the tall box for the light sampling kernel
+    auto points = std::make_shared<std::vector<HitRecord>>();
+    {
+        std::vector<Ray> rays = rays_toward(list->bounding_box(), sampler);
+        for (const Ray& r : rays) {
+            HitRecord rec;
+            if (list->hit(r, 0, std::numeric_limits<Real>::infinity(), rec) && !scene.material(rec).is_emissive())
+                points->push_back(rec);
+        }
+    }
+    for (RectLightSampling mode : {RectLightSampling::Area, RectLightSampling::SolidAngle}) {
+        std::string name = std::string("sample_light_direct (") + rect_light_sampling_name(mode) + ")";
+        benches.push_back({name, [&scene, points, mode](uint64_t n) {
+            scene.lights.rect_sampling = mode;
+            Sampler s(kSeed);
+            double sum = 0.0;
+            const size_t m = points->size();
+            for (uint64_t i = 0; i < n; ++i) {
+                const HitRecord& rec = (*points)[i % m];
+                s.start_sample(static_cast<int>(i & 1023), 0, static_cast<int>(i >> 10));
+                sum += sample_light_direct(rec.p, rec.normal, scene, s).Li.x;
+            }
+            scene.lights.rect_sampling = RectLightSampling::Area;
+            return static_cast<uint64_t>(sum);
+        }});
+    }
+
+    // Shadow rays from those points to the light, closest-hit vs any-hit
+    auto shadow = std::make_shared<std::vector<LightSampleQuery>>();
+    {
+        Sampler s(kSeed);
+        for (size_t i = 0; i < points->size(); ++i) {
+            s.start_sample(static_cast<int>(i), 1, 0);
+            LightSampleQuery q = prepare_light_sample((*points)[i].p, (*points)[i].normal, scene, s);
+            if (q.valid) shadow->push_back(q);
+        }
+    }
+    benches.push_back({"BVH::hit shadow rays (cornell)", [bvh, shadow](uint64_t n) {
+        HitRecord rec;
+        uint64_t blocked = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            const LightSampleQuery& q = (*shadow)[i % shadow->size()];
+            blocked += bvh->hit(q.shadow_ray, 0, q.t_max, rec);
+        }
+        return blocked;
+    }});
+    benches.push_back({"BVH::occluded shadow rays (cornell)", [bvh, shadow](uint64_t n) {
+        uint64_t blocked = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            const LightSampleQuery& q = (*shadow)[i % shadow->size()];
+            blocked += bvh->occluded(q.shadow_ray, 0, q.t_max);
+        }
+        return blocked;
+    }});
+    benches.push_back({"StaticScene::occluded (cornell)", [static_scene, shadow](uint64_t n) {
+        uint64_t blocked = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            const LightSampleQuery& q = (*shadow)[i % shadow->size()];
+            blocked += static_scene->occluded(q.shadow_ray, 0, q.t_max);
+        }
+        return blocked;
+    }});
+
+    auto normals = std::make_shared<std::vector<Vec3>>();
+    for (size_t i = 0; i < kInputs; ++i) normals->push_back(random_unit_vector(sampler));
+    benches.push_back({"random_cosine_direction+onb_from_w", [normals](uint64_t n) {
+        Sampler s(kSeed);
+        s.start_sample(0, 0, 0);
+        double sum = 0.0;
+        for (uint64_t i = 0; i < n; ++i) {
+            Vec3 u, v, w;
+            onb_from_w((*normals)[i % kInputs], u, v, w);
+            Vec3 d = random_cosine_direction(s);
+            sum += (d.x * u + d.y * v + d.z * w).z;
+        }
+        return static_cast<uint64_t>(sum);
+    }, 0.0});
+
+    // One path's worth of sampler dimensions per op: the camera's 2, then 6 per vertex
+    // for 4 vertices, as laid out in sampler.h
+    for (SamplerKind kind : {SamplerKind::Independent, SamplerKind::Stratified, SamplerKind::Halton, SamplerKind::Sobol}) {
+        benches.push_back({std::string("Sampler path dims (") + sampler_kind_name(kind) + ")", [kind](uint64_t n) {
+            Sampler s(kSeed, kind, 64);
+            double sum = 0.0;
+            for (uint64_t i = 0; i < n; ++i) {
+                s.start_sample(static_cast<int>(i & 63), static_cast<int>((i >> 6) & 63), static_cast<int>((i >> 12) & 63));
+                sum += s.next_1d() + s.next_1d();
+                for (int v = 0; v < 4; ++v) {
+                    s.next_bounce();
+                    for (int d = 0; d < 6; ++d) sum += s.next_1d();
+                }
+            }
+            return static_cast<uint64_t>(sum);
+        }, 0.0});
+    }
+
+    Camera cam(Vec3(278, 278, -800), Vec3(278, 278, 0), Vec3(0, 1, 0), 40.0, 1.0);
+    benches.push_back({"Camera::get_ray", [cam](uint64_t n) {
+        double sum = 0.0;
+        const double inv = 1.0 / 1024;
+        for (uint64_t i = 0; i < n; ++i)
+            sum += cam.get_ray((i & 1023) * inv, ((i >> 10) & 1023) * inv).direction().x;
+        return static_cast<uint64_t>(sum);
+    }, 0.0});
+
+    // Primary rays of one 8x8 pixel block per op (a 64x64 image cycled), one at a
+    // time and as a RayPacket
+    auto block_rays = [cam](uint64_t op, Sampler& s, RayPacket& packet) {
+        int bx = static_cast<int>(op & 7) * 8, by = static_cast<int>((op >> 3) & 7) * 8;
+        packet.reset(cam.origin);
+        for (int y = by; y < by + 8; ++y) {
+            for (int x = bx; x < bx + 8; ++x) {
+                s.start_sample(x, y, static_cast<int>(op >> 6));
+                packet.add(jittered_camera_ray(cam, x, y, 64, 64, s).direction());
+            }
+        }
+        packet.finalize();
+    };
+    benches.push_back({"BVH::hit 8x8 camera rays (cornell)", [bvh, block_rays](uint64_t n) {
+        Sampler s(kSeed);
+        auto packet = std::make_unique<RayPacket>();
+        HitRecord rec;
+        uint64_t hits = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            block_rays(i, s, *packet);
+            for (int k = 0; k < packet->count; ++k)
+                hits += bvh->hit(packet->ray(k), 0, std::numeric_limits<Real>::infinity(), rec);
+        }
+        return hits;
+    }, 64.0});
+    benches.push_back({"BVH::hit_packet 8x8 (cornell)", [bvh, block_rays](uint64_t n) {
+        Sampler s(kSeed);
+        auto packet = std::make_unique<RayPacket>();
+        auto hits = std::make_unique<PacketHits>();
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            block_rays(i, s, *packet);
+            hits->reset();
+            bvh->hit_packet(*packet, packet->all, *hits);
+            count += static_cast<uint64_t>(__builtin_popcountll(hits->mask));
+        }
+        return count;
+    }, 64.0});
+
+    // Full camera paths, 64x64 pixels cycled: through the StaticScene with static
+    // material dispatch (the default), and through the BVH with virtual calls
+    // (--virtual_scene)
+    RenderSettings settings;  // max_depth 10, min_depth 4, MIS on
+    for (bool virtual_scene : {false, true}) {
+        std::string name = virtual_scene ? "ray_color (cornell path, virtual)" : "ray_color (cornell path)";
+        std::shared_ptr<Hittable> accel = virtual_scene ? std::shared_ptr<Hittable>(bvh) : static_scene;
+        benches.push_back({name, [&scene, accel, virtual_scene, cam, settings](uint64_t n) {
+            scene.accel = accel;
+            scene.materials.static_dispatch = !virtual_scene;
+            Sampler s(kSeed);
+            double sum = 0.0;
+            for (uint64_t i = 0; i < n; ++i) {
+                int px = static_cast<int>(i & 63), py = static_cast<int>((i >> 6) & 63);
+                s.start_sample(px, py, static_cast<int>(i >> 12));
+                Ray r = jittered_camera_ray(cam, px, py, 64, 64, s);
+                sum += ray_color(r, scene, settings, settings.max_depth, settings.min_depth, s).y;
+            }
+            return static_cast<uint64_t>(sum);
+        }, 0.0, true});
+    }
+
+    std::vector<BenchResult> results;
+    std::cout << std::left << std::setw(38) << "benchmark" << std::right << std::setw(12) << "ns/op"
+              << std::setw(12) << "Mrays/s" << std::setw(14) << "ops\n";
+    for (const Benchmark& b : benches) {
+        if (!filter.empty() && b.name.find(filter) == std::string::npos) continue;
+        BenchResult r = run(b, min_time, repeats);
+        results.push_back(r);
+        std::cout << std::left << std::setw(38) << r.name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << r.ns_per_op << std::setw(12);
+        if (r.mrays_per_s > 0.0) std::cout << r.mrays_per_s;
+        else std::cout << "-";
+        std::cout << std::setw(13) << r.ops << '\n';
+    }
+
+    if (!json_path.empty()) write_json(json_path, results);
+    if (!csv_path.empty()) write_csv(csv_path, results);
+    return 0;
+}
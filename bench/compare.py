@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+"""Compara dois resultados de path_tracer_bench (--json ou --csv).
+
+    python3 bench/compare.py antes.json depois.json [--threshold 5]
+
+Lista ns/op de cada benchmark nos dois arquivos e a variação; sai com código 1
+se algum ficou mais lento que o limiar (em %), para uso em scripts.
+"""
+import csv
+import json
+import sys
+
+
+def load(path):
+    if path.endswith(".csv"):
+        with open(path) as f:
+            return {row["name"]: float(row["ns_per_op"]) for row in csv.DictReader(f)}
+    with open(path) as f:
+        return {b["name"]: float(b["ns_per_op"]) for b in json.load(f)["benchmarks"]}
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    threshold = 5.0
+    if "--threshold" in sys.argv:
+        threshold = float(sys.argv[sys.argv.index("--threshold") + 1])
+        args.remove(sys.argv[sys.argv.index("--threshold") + 1])
+    if len(args) != 2:
+        print(__doc__)
+        return 2
+
+    before, after = load(args[0]), load(args[1])
+    regressions = 0
+    print(f"{'benchmark':38}{'antes':>12}{'depois':>12}{'variação':>11}")
+    for name in before:
+        if name not in after:
+            continue
+        change = (after[name] / before[name] - 1.0) * 100.0
+        flag = "  <-- mais lento" if change > threshold else ""
+        regressions += change > threshold
+        print(f"{name:38}{before[name]:12.2f}{after[name]:12.2f}{change:+10.1f}%{flag}")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Curvas de convergência dos samplers (--sampler): RMSE x spp contra uma referência.
+
+    python3 bench/convergence.py --binary build/path_tracer --reference ref.pfm \\
+        [--spp 4,8,16,32,64,128] [--samplers independent,stratified,halton,sobol] \\
+        [--reference_spp 4096] [--workdir conv] [-- flags extras do path_tracer]
+
+Se a referência não existir, ela é renderizada primeiro (sampler independente,
+outra semente, --reference_spp amostras). Todas as renderizações de teste vão num
+único job file (--jobs), então a cena é montada uma vez só. Imprime o RMSE de
+cada (sampler, spp) e, comparando com a reta log-log do sampler independente,
+quantas amostras independentes cada ponto vale ("spp equivalentes").
+"""
+import argparse
+import math
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from image_diff import load_pfm  # noqa: E402
+
+
+def rmse(ref, img):
+    return math.sqrt(sum((a - b) ** 2 for a, b in zip(ref, img)) / len(ref))
+
+
+def fit_loglog(points):
+    """Least squares log(rmse) = a + b log(spp)."""
+    xs = [math.log(s) for s, _ in points]
+    ys = [math.log(r) for _, r in points]
+    mx, my = sum(xs) / len(xs), sum(ys) / len(ys)
+    b = sum((x - mx) * (y - my) for x, y in zip(xs, ys)) / sum((x - mx) ** 2 for x in xs)
+    return my - b * mx, b
+
+
+def main():
+    argv = sys.argv[1:]
+    extra = []
+    if "--" in argv:
+        extra = argv[argv.index("--") + 1:]
+        argv = argv[:argv.index("--")]
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--binary", default="build/path_tracer")
+    ap.add_argument("--reference", required=True)
+    ap.add_argument("--reference_spp", type=int, default=4096)
+    ap.add_argument("--spp", default="4,8,16,32,64,128")
+    ap.add_argument("--samplers", default="independent,stratified,halton,sobol")
+    ap.add_argument("--workdir", default="convergence")
+    args = ap.parse_args(argv)
+
+    spps = [int(s) for s in args.spp.split(",")]
+    samplers = args.samplers.split(",")
+    os.makedirs(args.workdir, exist_ok=True)
+
+    if not os.path.exists(args.reference):
+        print(f"rendering the reference {args.reference} ({args.reference_spp} spp)", flush=True)
+        subprocess.run([args.binary, *extra, "--samples", str(args.reference_spp), "--seed", "7919",
+                        "--output", args.reference], check=True)
+
+    jobs_path = os.path.join(args.workdir, "convergence.jobs")
+    outputs = {}
+    with open(jobs_path, "w") as f:
+        for sampler in samplers:
+            for spp in spps:
+                out = os.path.join(args.workdir, f"{sampler}_{spp}.pfm")
+                outputs[(sampler, spp)] = out
+                f.write(f"--sampler {sampler} --samples {spp} --output {out}\n")
+    subprocess.run([args.binary, *extra, "--jobs", jobs_path,
+                    "--jobs_report", os.path.join(args.workdir, "batch_report.json")], check=True)
+
+    _, _, ref = load_pfm(args.reference)
+    errors = {key: rmse(ref, load_pfm(path)[2]) for key, path in outputs.items()}
+
+    print()
+    print("RMSE".ljust(14) + "".join(f"{spp:>11}" for spp in spps) + "   slope")
+    fits = {}
+    for sampler in samplers:
+        points = [(spp, errors[(sampler, spp)]) for spp in spps]
+        fits[sampler] = fit_loglog(points) if len(points) > 1 else None
+        slope = f"{fits[sampler][1]:8.2f}" if fits[sampler] else ""
+        print(sampler.ljust(14) + "".join(f"{r:11.5f}" for _, r in points) + slope)
+
+    if fits.get("independent"):
+        a, b = fits["independent"]
+        print()
+        print("spp equivalentes (independente com o mesmo RMSE)")
+        print("".ljust(14) + "".join(f"{spp:>11}" for spp in spps))
+        for sampler in samplers:
+            row = "".join(f"{math.exp((math.log(errors[(sampler, spp)]) - a) / b):11.1f}" for spp in spps)
+            print(sampler.ljust(14) + row)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""Compara duas imagens PFM do path_tracer (--output x.pfm).
+
+    python3 bench/image_diff.py referencia.pfm teste.pfm
+
+Imprime a média de cada imagem, o RMSE, o RMSE relativo (normalizado pela média
+da referência), o maior erro absoluto e quantos pixels diferem mais de 5%.
+Sem dependências além da biblioteca padrão.
+"""
+import math
+import struct
+import sys
+
+
+def load_pfm(path):
+    with open(path, "rb") as f:
+        header = f.readline().strip()
+        if header not in (b"PF", b"Pf"):
+            raise ValueError(f"{path}: not a PFM file")
+        channels = 3 if header == b"PF" else 1
+        width, height = (int(v) for v in f.readline().split())
+        scale = float(f.readline())
+        fmt = "<" if scale < 0 else ">"
+        count = width * height * channels
+        data = struct.unpack(fmt + "f" * count, f.read(4 * count))
+    return width, height, data
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        return 2
+    w0, h0, ref = load_pfm(sys.argv[1])
+    w1, h1, img = load_pfm(sys.argv[2])
+    if (w0, h0, len(ref)) != (w1, h1, len(img)):
+        print("as imagens têm tamanhos diferentes")
+        return 2
+
+    n = len(ref)
+    mean_ref = sum(ref) / n
+    mean_img = sum(img) / n
+    sq = sum((a - b) ** 2 for a, b in zip(ref, img))
+    rmse = math.sqrt(sq / n)
+    max_abs = max(abs(a - b) for a, b in zip(ref, img))
+    off = sum(1 for a, b in zip(ref, img) if abs(a - b) > 0.05 * max(abs(a), 1e-3))
+
+    print(f"média referência   {mean_ref:.6f}")
+    print(f"média teste        {mean_img:.6f}  ({(mean_img / mean_ref - 1) * 100:+.3f}%)")
+    print(f"RMSE               {rmse:.6f}")
+    print(f"RMSE relativo      {rmse / mean_ref:.6f}")
+    print(f"maior erro         {max_abs:.6f}")
+    print(f"canais > 5%        {off} de {n} ({off / n * 100:.2f}%)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
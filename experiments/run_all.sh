@@ -12,25 +12,19 @@ fi
 cmake --build ../build -j${JOBS}
 mkdir -p ../experiments
 
-# 1) Ruído vs spp
+# 1) Ruído vs spp: uma única renderização progressiva até 800 spp grava 50 e 200 no caminho
+../build/path_tracer --samples 800 --snapshots 50,200,800 --output noise.ppm && rm -f noise.ppm
 for spp in 50 200 800; do
-  ../build/path_tracer --samples $spp
-  mv output.ppm "noise_${spp}spp.ppm"
   if command -v convert >/dev/null 2>&1; then
     convert "noise_${spp}spp.ppm" "noise_${spp}spp.png"
   fi
 done
 
-# 2) MIS on/off
-../build/path_tracer --samples 200 --mis_off && mv output.ppm mis_off_200.ppm
-if command -v convert >/dev/null 2>&1; then convert mis_off_200.ppm mis_off_200.png; fi
-../build/path_tracer --samples 200           && mv output.ppm mis_on_200.ppm
-if command -v convert >/dev/null 2>&1; then convert mis_on_200.ppm mis_on_200.png; fi
-
-# 3) Min depth
-../build/path_tracer --samples 200 --min_depth 1 && mv output.ppm min1_200.ppm
-if command -v convert >/dev/null 2>&1; then convert min1_200.ppm min1_200.png; fi
-../build/path_tracer --samples 200 --min_depth 4 && mv output.ppm min4_200.ppm
-if command -v convert >/dev/null 2>&1; then convert min4_200.ppm min4_200.png; fi
+# 2) MIS on/off e 3) min depth: um único processo monta a cena uma vez e
+# renderiza os jobs de sweep.jobs; tempos e contadores vão para sweep_report.json
+../build/path_tracer --jobs sweep.jobs --jobs_report sweep_report.json
+for img in mis_off_200 mis_on_200 min1_200 min4_200; do
+  if command -v convert >/dev/null 2>&1; then convert "${img}.ppm" "${img}.png"; fi
+done
 
 echo "Experimentos concluídos. Arquivos gerados em experiments/" 
\ No newline at end of file
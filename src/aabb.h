@@ -0,0 +1,68 @@
+#pragma once
+#include "ray.h"
+#include <algorithm>
+#include <limits>
+
+// Axis-aligned bounding box. The default box is empty (min = +inf, max = -inf) so
+// that growing it with expand() starts from nothing.
+class AABB {
+public:
+    Vec3 minimum;
+    Vec3 maximum;
+
+    AABB()
+        : minimum( std::numeric_limits<Real>::infinity(),  std::numeric_limits<Real>::infinity(),  std::numeric_limits<Real>::infinity()),
+          maximum(-std::numeric_limits<Real>::infinity(), -std::numeric_limits<Real>::infinity(), -std::numeric_limits<Real>::infinity()) {}
+    AABB(const Vec3& a, const Vec3& b) : minimum(a), maximum(b) {}
+
+    void expand(const Vec3& p) {
+        minimum = Vec3(std::min(minimum.x, p.x), std::min(minimum.y, p.y), std::min(minimum.z, p.z));
+        maximum = Vec3(std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z));
+    }
+
+    void expand(const AABB& b) {
+        if (b.empty()) return;
+        expand(b.minimum);
+        expand(b.maximum);
+    }
+
+    bool empty() const { return minimum.x > maximum.x; }
+
+    Vec3 centroid() const { return 0.5 * (minimum + maximum); }
+
+    Real surface_area() const {
+        if (empty()) return 0.0;
+        Vec3 d = maximum - minimum;
+        return 2.0 * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    // Slab test with a precomputed reciprocal direction. On a hit, t_entry holds the
+    // distance at which the ray enters the box (clamped to t_min).
+    bool hit(const Vec3& origin, const Vec3& inv_dir, Real t_min, Real t_max, Real& t_entry) const {
+        Real tx0 = (minimum.x - origin.x) * inv_dir.x;
+        Real tx1 = (maximum.x - origin.x) * inv_dir.x;
+        if (tx0 > tx1) std::swap(tx0, tx1);
+        Real ty0 = (minimum.y - origin.y) * inv_dir.y;
+        Real ty1 = (maximum.y - origin.y) * inv_dir.y;
+        if (ty0 > ty1) std::swap(ty0, ty1);
+        Real tz0 = (minimum.z - origin.z) * inv_dir.z;
+        Real tz1 = (maximum.z - origin.z) * inv_dir.z;
+        if (tz0 > tz1) std::swap(tz0, tz1);
+
+        t_entry = std::max(std::max(tx0, ty0), std::max(tz0, t_min));
+        Real t_exit = std::min(std::min(tx1, ty1), std::min(tz1, t_max));
+        return t_entry <= t_exit;
+    }
+
+    bool hit(const Ray& r, Real t_min, Real t_max) const {
+        Vec3 inv_dir(1.0 / r.direction().x, 1.0 / r.direction().y, 1.0 / r.direction().z);
+        Real t_entry;
+        return hit(r.origin(), inv_dir, t_min, t_max, t_entry);
+    }
+};
+
+inline AABB surrounding_box(const AABB& a, const AABB& b) {
+    AABB box = a;
+    box.expand(b);
+    return box;
+}
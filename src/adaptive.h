@@ -0,0 +1,143 @@
+#pragma once
+#include "path_tracer.h"
+#include "image.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+struct AdaptiveSettings {
+    double threshold = 0.02;     // erro relativo alvo (desvio padrão da média / média)
+    int min_samples = 16;        // amostras iniciais em todos os pixels
+    int max_pixel_samples = 0;   // 0 = 8x a média (settings.samples_per_pixel)
+    std::string sample_map_path; // vazio = não grava o mapa de amostras
+};
+
+struct AdaptiveResult {
+    long long total_samples = 0;
+    int rounds = 0;
+    double seconds = 0.0;
+};
+
+// Adaptive sampling. Every pixel keeps its radiance sum, sample count, and the sum
+// and sum of squares of its sample luminance. After an initial pass of
+// min_samples, rounds are repeated in which only the pixels whose relative
+// standard error (max over their 3x3 neighbourhood, so a pixel that has not yet
+// seen the rare bright path is not retired on a lucky streak) is above the
+// threshold receive more samples. The total is capped at samples_per_pixel times
+// the pixel count; when a round does not fit, the noisiest pixels go first.
+//
+// `mean` receives the per-pixel average radiance (already divided by each pixel's
+// own count) and `counts` the number of samples each pixel received.
+inline AdaptiveResult render_adaptive(const Scene& scene, const Camera& cam, const RenderSettings& settings,
+                                      const AdaptiveSettings& adaptive, Framebuffer& mean, std::vector<float>& counts) {
+    const int width = settings.image_width;
+    const int height = settings.image_height;
+    const size_t pixels = static_cast<size_t>(width) * height;
+    const long long budget = static_cast<long long>(settings.samples_per_pixel) * static_cast<long long>(pixels);
+    const int max_pixel = adaptive.max_pixel_samples > 0 ? adaptive.max_pixel_samples : 8 * settings.samples_per_pixel;
+
+    Framebuffer sum(width, height);
+    std::vector<double> lum_sum(pixels, 0.0), lum_sq(pixels, 0.0);
+    std::vector<int> count(pixels, 0);
+    std::vector<int> alloc(pixels, std::min({adaptive.min_samples, settings.samples_per_pixel, max_pixel}));
+    std::vector<double> error(pixels, 0.0), error_max(pixels, 0.0);
+
+    std::vector<Tile> tiles = make_tiles(width, height, settings.tile_size);
+    WorkStealingScheduler scheduler(resolve_thread_count(settings.num_threads));
+    std::cerr << "Adaptive sampling: threshold " << adaptive.threshold << ", budget " << settings.samples_per_pixel
+              << " spp average, " << max_pixel << " spp max per pixel\n";
+
+    AdaptiveResult result;
+    auto start = std::chrono::steady_clock::now();
+
+    while (true) {
+        scheduler.run(tiles.size(), [&](size_t tile_index, int) {
+            const Tile& tile = tiles[tile_index];
+            Sampler sampler(settings.seed, settings.sampler, settings.samples_per_pixel);
+            for (int row = tile.y0; row < tile.y1; ++row) {
+                int j = height - 1 - row;
+                for (int i = tile.x0; i < tile.x1; ++i) {
+                    size_t p = static_cast<size_t>(row) * width + i;
+                    if (alloc[p] <= 0) continue;
+                    Vec3 pixel_color(0, 0, 0);
+                    double ls = 0.0, lq = 0.0;
+                    for (int s = count[p]; s < count[p] + alloc[p]; ++s) {
+                        sampler.start_sample(i, j, s);
+                        Ray r = jittered_camera_ray(cam, i, j, width, height, sampler);
+                        Vec3 c = ray_color(r, scene, settings, settings.max_depth, settings.min_depth, sampler);
+                        double l = 0.2126 * c.x + 0.7152 * c.y + 0.0722 * c.z;
+                        pixel_color += c;
+                        ls += l;
+                        lq += l * l;
+                    }
+                    sum.add(p, pixel_color);
+                    lum_sum[p] += ls;
+                    lum_sq[p] += lq;
+                    count[p] += alloc[p];
+
+                    // Relative standard error of the pixel mean
+                    double n = count[p];
+                    double m = lum_sum[p] / n;
+                    double var = n > 1 ? std::max(0.0, (lum_sq[p] - n * m * m) / (n - 1)) : 0.0;
+                    error[p] = std::sqrt(var / n) / (m + 1e-3);
+                }
+            }
+        });
+
+        for (size_t p = 0; p < pixels; ++p) result.total_samples += alloc[p];
+        ++result.rounds;
+
+        // Dilate the error over 3x3 neighbourhoods
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                double e = 0.0;
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        int xx = std::clamp(x + dx, 0, width - 1), yy = std::clamp(y + dy, 0, height - 1);
+                        e = std::max(e, error[static_cast<size_t>(yy) * width + xx]);
+                    }
+                error_max[static_cast<size_t>(y) * width + x] = e;
+            }
+        }
+
+        std::vector<uint32_t> active;
+        long long wanted = 0;
+        for (size_t p = 0; p < pixels; ++p) {
+            alloc[p] = 0;
+            if (error_max[p] <= adaptive.threshold || count[p] >= max_pixel) continue;
+            alloc[p] = std::min(std::max(4, count[p] / 2), max_pixel - count[p]);
+            wanted += alloc[p];
+            active.push_back(static_cast<uint32_t>(p));
+        }
+
+        long long remaining = budget - result.total_samples;
+        std::cerr << "Round " << result.rounds << ": " << active.size() << " pixels above threshold, "
+                  << static_cast<double>(result.total_samples) / pixels << " spp average so far      \n";
+        if (active.empty() || remaining <= 0) break;
+
+        if (wanted > remaining) {
+            // Not enough budget for everyone: serve the noisiest pixels first
+            std::sort(active.begin(), active.end(), [&](uint32_t a, uint32_t b) { return error_max[a] > error_max[b]; });
+            for (uint32_t p : active) {
+                alloc[p] = static_cast<int>(std::min<long long>(alloc[p], remaining));
+                remaining -= alloc[p];
+            }
+        }
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    mean = Framebuffer(width, height);
+    counts.assign(pixels, 0.0f);
+    for (size_t p = 0; p < pixels; ++p) {
+        if (count[p] > 0) mean.set(p, sum.get(p) / count[p]);
+        counts[p] = static_cast<float>(count[p]);
+    }
+    std::cerr << "Done in " << result.seconds << " s: " << result.rounds << " rounds, "
+              << static_cast<double>(result.total_samples) / pixels << " spp average.          \n";
+    return result;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "vec3.h"
+#include "aabb.h"
+#include "hittable.h"
+#include "image.h"
+#include "sampler.h"
+#include "sd_tree.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Coarse adjoint for adjoint-driven Russian roulette and splitting (--rr adrrs),
+// after Vorba & Křivánek 2016. A pre-pass records, at every path vertex, the
+// luminance of the indirect radiance the vertex reflects (what continuing the path
+// past its light sample brings back) into a grid over the scene, one cell per
+// (voxel, dominant normal direction); the pre-pass image, denoised, estimates each
+// pixel. Continuing a path of throughput `w` at x is expected to add
+// w * L_ind(x) / I(pixel) of its pixel: that ratio is kept inside a window around 1
+// by killing continuations below it and splitting those above it.
+class AdjointCache {
+public:
+    static constexpr int kResolution = 16;        // voxels along the longest side of the scene
+    static constexpr uint32_t kMinRecords = 16;   // menos que isso: sem estimativa, roleta clássica
+    // Janela [2/(1+s), 2s/(1+s)] em torno da contribuição esperada. O artigo usa s = 5 e
+    // até 8 ramos; nas Cornell boxes isso matava e dividia demais para o custo em raios
+    static constexpr double kWindowRatio = 20.0;
+    static constexpr int kMaxSplits = 2;
+    static constexpr double kMinSurvival = 0.05;  // a estimativa pode ser 0 onde L_r não é
+
+    bool recording = true;   // pre-pass: records and leaves the roulette alone
+
+    AdjointCache(const AABB& scene_bounds, int width, int height)
+        : origin(scene_bounds.minimum), width(width), height(height) {
+        Vec3 extent = scene_bounds.maximum - scene_bounds.minimum;
+        Real side = std::max(extent.x, std::max(extent.y, extent.z)) * Real(1.001) + Real(1e-3);
+        inv_voxel = kResolution / side;
+        const Real e[3] = {extent.x, extent.y, extent.z};
+        for (int a = 0; a < 3; ++a) dims[a] = std::max(1, static_cast<int>(std::ceil(e[a] * inv_voxel)));
+        cells.resize(static_cast<size_t>(dims[0]) * dims[1] * dims[2] * 6);
+    }
+
+    // Luminance of the indirect radiance reflected at `rec` (pre-pass, lock-free)
+    void record(const HitRecord& rec, float value) {
+        if (!std::isfinite(value)) return;
+        Cell& c = cells[cell_index(rec)];
+        guiding_detail::atomic_add(c.sum, value);
+        __atomic_fetch_add(&c.count, 1u, __ATOMIC_RELAXED);
+    }
+
+    // Pixel estimates from the mean pre-pass image; dark pixels are raised to a small
+    // fraction of the image mean so the ratio stays finite
+    void set_pixels(const Framebuffer& mean) {
+        pixels.resize(mean.pixel_count());
+        double total = 0.0;
+        for (size_t p = 0; p < pixels.size(); ++p) {
+            pixels[p] = guiding_detail::luminance(mean.get(p));
+            total += pixels[p];
+        }
+        const float floor = static_cast<float>(std::max(1e-3 * total / std::max<size_t>(pixels.size(), 1), 1e-6));
+        for (float& v : pixels) v = std::max(v, floor);
+    }
+
+    size_t estimated_cells() const {
+        return static_cast<size_t>(std::count_if(cells.begin(), cells.end(), [](const Cell& c) { return c.count >= kMinRecords; }));
+    }
+    size_t cell_count() const { return cells.size(); }
+
+    // Expected share of its pixel for continuing a path of throughput luminance
+    // `weight` at `rec`, or -1 where the cache has no estimate
+    double contribution(const HitRecord& rec, const Sampler& sampler, double weight) const {
+        const Cell& c = cells[cell_index(rec)];
+        if (c.count < kMinRecords || pixels.empty()) return -1.0;
+        const size_t pixel = static_cast<size_t>(height - 1 - sampler.pixel_y()) * width + sampler.pixel_x();
+        return weight * (c.sum / c.count) / pixels[pixel];
+    }
+
+    // Weight window: below it the path survives with probability `survival`, above
+    // it it continues as `splits` paths of 1/splits the weight
+    static void window(double contribution, double& survival, int& splits) {
+        const double lower = 2.0 / (1.0 + kWindowRatio);
+        const double upper = kWindowRatio * lower;
+        survival = 1.0;
+        splits = 1;
+        if (contribution < lower)
+            survival = std::max(contribution, kMinSurvival);   // quem sobrevive volta ao centro
+        else if (contribution > upper)
+            splits = std::min(static_cast<int>(std::lround(contribution)), kMaxSplits);
+    }
+
+private:
+    struct Cell {
+        float sum = 0.0f;
+        uint32_t count = 0;
+    };
+
+    Vec3 origin;
+    Real inv_voxel = 1;
+    int dims[3] = {1, 1, 1};
+    int width, height;
+    std::vector<Cell> cells;
+    std::vector<float> pixels;
+
+    size_t cell_index(const HitRecord& rec) const {
+        const Vec3 q = (rec.p - origin) * inv_voxel;
+        const Real d[3] = {q.x, q.y, q.z};
+        int v[3];
+        for (int a = 0; a < 3; ++a) v[a] = std::clamp(static_cast<int>(d[a]), 0, dims[a] - 1);
+        // Eixo dominante da normal e seu sinal: chão e parede no mesmo voxel não se misturam
+        const Real n[3] = {rec.normal.x, rec.normal.y, rec.normal.z};
+        int axis = std::fabs(n[0]) >= std::fabs(n[1]) ? (std::fabs(n[0]) >= std::fabs(n[2]) ? 0 : 2)
+                                                      : (std::fabs(n[1]) >= std::fabs(n[2]) ? 1 : 2);
+        int side = n[axis] < 0 ? 1 : 0;
+        return ((static_cast<size_t>(v[2]) * dims[1] + v[1]) * dims[0] + v[0]) * 6 + axis * 2 + side;
+    }
+};
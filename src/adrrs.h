@@ -0,0 +1,45 @@
+#pragma once
+#include "path_tracer.h"
+#include "adjoint_cache.h"
+#include "denoise.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// Adjoint-driven Russian roulette and splitting (--rr adrrs): the first
+// `prepass_samples` samples per pixel are traced with the classic roulette while
+// every vertex records its reflected radiance into an AdjointCache; the pre-pass
+// image, denoised with its own AOVs, becomes the pixel estimate, and the remaining
+// samples roulette and split against the cache. Both passes add to `framebuffer`.
+// Returns the wall-clock time spent tracing and building the estimates.
+inline double render_adrrs(const Scene& scene, const Camera& cam, const RenderSettings& settings, int prepass_samples,
+                           Framebuffer& framebuffer, AovBuffers* aovs = nullptr) {
+    const int w = settings.image_width, h = settings.image_height;
+    framebuffer = Framebuffer(w, h);
+    AdjointCache cache(scene.world().bounding_box(), w, h);
+    RenderSettings adrrs = settings;
+    adrrs.adjoint = &cache;
+
+    const int target = settings.samples_per_pixel;
+    prepass_samples = std::clamp(prepass_samples, 1, target);
+    std::cerr << "ADRRS rendering on " << resolve_thread_count(settings.num_threads) << " threads, " << prepass_samples
+              << " of " << target << " spp pre-pass\n";
+
+    AovBuffers prepass_aovs(w, h);
+    double total_seconds = render_pass(scene, cam, adrrs, framebuffer, 0, prepass_samples, &prepass_aovs);
+    auto estimate_start = std::chrono::steady_clock::now();
+    // As AOVs pedidas recebem também as amostras da pré-passada
+    if (aovs) *aovs = prepass_aovs;
+    prepass_aovs.finish(prepass_samples);
+    cache.set_pixels(denoise(framebuffer, 1.0 / prepass_samples, prepass_aovs, DenoiseSettings(), settings.num_threads));
+    cache.recording = false;
+    total_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - estimate_start).count();
+    std::cerr << "Pre-pass done: " << cache.estimated_cells() << " of " << cache.cell_count()
+              << " cache cells estimated      \n";
+
+    if (prepass_samples < target)
+        total_seconds += render_pass(scene, cam, adrrs, framebuffer, prepass_samples, target - prepass_samples, aovs);
+    if (aovs) aovs->finish(target);
+    std::cerr << "Done in " << total_seconds << " s.          \n";
+    return total_seconds;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "image.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Auxiliary output buffers (--aov, --denoise), same layout as the Framebuffer (row 0 =
+// top). During the render they hold per-pixel sums over the samples of the first
+// hit's albedo, shading normal and distance, and the luminance moments of the
+// samples; finish() turns them into means and a variance.
+class AovBuffers {
+public:
+    int width = 0;
+    int height = 0;
+    Framebuffer albedo;          // Material::aov_albedo() of the first hit, 0 on a miss
+    Framebuffer normal;          // shading normal facing the camera, 0 on a miss
+    std::vector<float> depth;    // distance along the camera ray, 0 on a miss
+    std::vector<float> variance; // of the pixel's mean luminance (sample variance / n)
+
+    AovBuffers() {}
+    AovBuffers(int w, int h)
+        : width(w), height(h), albedo(w, h), normal(w, h), depth(albedo.pixel_count(), 0.0f),
+          variance(albedo.pixel_count(), 0.0f), luminance_sum(albedo.pixel_count(), 0.0),
+          luminance_sq(albedo.pixel_count(), 0.0) {}
+
+    size_t pixel_count() const { return albedo.pixel_count(); }
+
+    // One camera sample of `pixel`: its first hit (when `hit`) and its radiance
+    void add_sample(size_t pixel, bool hit, const Vec3& first_albedo, const Vec3& first_normal, double distance,
+                    const Vec3& color) {
+        if (hit) {
+            albedo.add(pixel, first_albedo);
+            normal.add(pixel, first_normal);
+            depth[pixel] += static_cast<float>(distance);
+        }
+        double l = 0.2126 * color.x + 0.7152 * color.y + 0.0722 * color.z;
+        luminance_sum[pixel] += l;
+        luminance_sq[pixel] += l * l;
+    }
+
+    // Averages over `samples` per pixel; misses count as zeros, like the radiance
+    void finish(int samples) {
+        const double n = std::max(samples, 1);
+        for (size_t p = 0; p < pixel_count(); ++p) {
+            albedo.set(p, albedo.get(p) / n);
+            Vec3 nrm = normal.get(p);
+            double len = nrm.length();
+            normal.set(p, len > 0.0 ? nrm / len : Vec3(0, 0, 0));
+            depth[p] = static_cast<float>(depth[p] / n);
+            double mean = luminance_sum[p] / n;
+            double sample_variance = n > 1 ? std::max(0.0, luminance_sq[p] - n * mean * mean) / (n - 1) : 0.0;
+            variance[p] = static_cast<float>(sample_variance / n);
+        }
+        luminance_sum = std::vector<double>();
+        luminance_sq = std::vector<double>();
+    }
+
+private:
+    // Em double: com centenas de amostras, E[x^2] - E[x]^2 em float perde tudo
+    std::vector<double> luminance_sum, luminance_sq;
+};
+
+// Writes <prefix>_albedo.pfm, _normal.pfm, _depth.pfm and _variance.pfm (raw values).
+inline bool write_aovs(const AovBuffers& aovs, const std::string& prefix) {
+    bool ok = write_pfm(aovs.albedo, prefix + "_albedo.pfm", 1.0) &&
+              write_pfm(aovs.normal, prefix + "_normal.pfm", 1.0) &&
+              write_heatmap(aovs.depth, aovs.width, aovs.height, prefix + "_depth.pfm") &&
+              write_heatmap(aovs.variance, aovs.width, aovs.height, prefix + "_variance.pfm");
+    return ok;
+}
@@ -0,0 +1,207 @@
+#pragma once
+#include "path_tracer.h"
+#include "scene_file.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Batch mode (--jobs arquivo): one render per line of the job file, written with the
+// same flags as the command line; '#' starts a comment. Every line starts from the
+// command-line settings, so common options can be given once:
+//
+//   # ./path_tracer --width 300 --height 300 --jobs sweep.jobs
+//   --samples 200 --mis_off       --output mis_off_200.ppm
+//   --samples 200 --min_depth 1   --output min1_200.ppm
+//
+// The scene is built once and shared read-only. The tiles of all jobs go to a single
+// work-stealing scheduler, so the jobs share the cores instead of each one paying
+// process start-up and scene setup. Each job's timing and traversal counters are
+// printed and written to --jobs_report (JSON).
+
+struct RenderJob {
+    RenderSettings settings;
+    std::vector<std::string> outputs;
+    int line = 0;
+
+    // Filled in by run_batch()
+    double seconds = 0.0;       // wall clock from the job's first tile to its last
+    double tile_seconds = 0.0;  // summed over workers
+    BVHTraversalStats traversal;
+};
+
+inline bool load_job_file(const std::string& path, const RenderSettings& defaults, std::vector<RenderJob>& jobs) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Could not open job file " << path << '\n';
+        return false;
+    }
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line)) {
+        ++line_number;
+        std::istringstream ls(line.substr(0, line.find('#')));
+        std::vector<std::string> tokens;
+        for (std::string token; ls >> token;) tokens.push_back(token);
+        if (tokens.empty()) continue;
+
+        std::vector<char*> args;
+        for (std::string& token : tokens) args.push_back(&token[0]);
+        RenderJob job;
+        job.settings = defaults;
+        job.line = line_number;
+        for (int i = 0; i < static_cast<int>(args.size()); ++i) {
+            if (!parse_render_flag(static_cast<int>(args.size()), args.data(), i, job.settings, job.outputs)) {
+                std::cerr << path << ':' << line_number << ": unknown or incomplete job option '" << args[i] << "'\n";
+                return false;
+            }
+        }
+        if (job.outputs.empty()) {
+            std::cerr << path << ':' << line_number << ": job without --output\n";
+            return false;
+        }
+        for (const RenderJob& other : jobs) {
+            for (const std::string& output : job.outputs) {
+                if (std::find(other.outputs.begin(), other.outputs.end(), output) != other.outputs.end()) {
+                    std::cerr << path << ':' << line_number << ": " << output << " is also written by line " << other.line << '\n';
+                    return false;
+                }
+            }
+        }
+        jobs.push_back(job);
+    }
+    if (jobs.empty()) {
+        std::cerr << "No jobs in " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+inline bool write_job_report(const std::string& path, const std::vector<RenderJob>& jobs, double total_seconds) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << std::setprecision(6) << "{\n  \"total_seconds\": " << total_seconds << ",\n  \"jobs\": [\n";
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const RenderJob& job = jobs[i];
+        const RenderSettings& s = job.settings;
+        const double rays = static_cast<double>(job.traversal.rays);
+        out << "    {\"line\": " << job.line << ", \"outputs\": [";
+        for (size_t k = 0; k < job.outputs.size(); ++k) out << (k ? ", " : "") << '"' << job.outputs[k] << '"';
+        out << "], \"width\": " << s.image_width << ", \"height\": " << s.image_height
+            << ", \"samples\": " << s.samples_per_pixel << ", \"min_depth\": " << s.min_depth
+            << ", \"mis\": " << (s.use_mis ? "true" : "false") << ", \"seed\": " << s.seed
+            << ", \"sampler\": \"" << sampler_kind_name(s.sampler) << '"'
+            << ", \"integrator\": \"" << (s.integrator == IntegratorKind::Wavefront ? "wavefront" : "recursive") << '"'
+            << ", \"seconds\": " << job.seconds << ", \"cpu_seconds\": " << job.tile_seconds
+            << ", \"rays\": " << job.traversal.rays
+            << ", \"nodes_per_ray\": " << (rays > 0 ? job.traversal.nodes_visited / rays : 0.0)
+            << ", \"mrays_per_cpu_second\": " << (job.tile_seconds > 0 ? rays / job.tile_seconds / 1e6 : 0.0) << "}"
+            << (i + 1 < jobs.size() ? "," : "") << '\n';
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Renders every job against the shared scene and writes their outputs.
+inline bool run_batch(const Scene& scene, const CameraDesc& camera_desc, std::vector<RenderJob>& jobs, int num_threads,
+                      const std::string& report_path) {
+    using clock = std::chrono::steady_clock;
+    WorkStealingScheduler scheduler(resolve_thread_count(num_threads));
+
+    // Per-job state; the wavefront integrators are created lazily, one per worker
+    struct JobState {
+        Camera cam;
+        Framebuffer framebuffer;
+        std::vector<Tile> tiles;
+        std::vector<std::unique_ptr<WavefrontIntegrator>> wavefront;
+        std::mutex mutex;
+        clock::time_point first_start = clock::time_point::max();
+        clock::time_point last_end = clock::time_point::min();
+    };
+    struct Task {
+        size_t job;
+        size_t tile;
+    };
+    std::vector<std::unique_ptr<JobState>> state;
+    std::vector<Task> tasks;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        const RenderSettings& s = jobs[j].settings;
+        auto st = std::make_unique<JobState>();
+        st->cam = camera_desc.make(static_cast<double>(s.image_width) / s.image_height);
+        st->framebuffer = Framebuffer(s.image_width, s.image_height);
+        st->tiles = make_tiles(s.image_width, s.image_height, s.tile_size);
+        st->wavefront.resize(scheduler.num_workers());
+        // Job-major order: the first jobs finish first while later ones fill idle workers
+        for (size_t t = 0; t < st->tiles.size(); ++t) tasks.push_back({j, t});
+        state.push_back(std::move(st));
+    }
+    std::cerr << "Batch: " << jobs.size() << " jobs, " << tasks.size() << " tiles on " << scheduler.num_workers()
+              << " threads\n";
+
+    auto start = clock::now();
+    std::mutex progress_mutex;
+    size_t tiles_done = 0;
+    scheduler.run(tasks.size(), [&](size_t index, int worker) {
+        const Task& task = tasks[index];
+        RenderJob& job = jobs[task.job];
+        JobState& st = *state[task.job];
+        WavefrontIntegrator* wavefront = nullptr;
+        if (job.settings.integrator == IntegratorKind::Wavefront) {
+            if (!st.wavefront[worker])
+                st.wavefront[worker] = std::make_unique<WavefrontIntegrator>(scene, st.cam, job.settings);
+            wavefront = st.wavefront[worker].get();
+        }
+
+        // The worker's own traversal counters, before and after: the difference is this tile's
+        const BVHTraversalStats before = bvh_detail::thread_counters.stats;
+        auto tile_start = clock::now();
+        render_tile(scene, st.cam, job.settings, st.tiles[task.tile], st.framebuffer, 0,
+                    job.settings.samples_per_pixel, wavefront);
+        auto tile_end = clock::now();
+        const BVHTraversalStats& after = bvh_detail::thread_counters.stats;
+
+        {
+            std::lock_guard<std::mutex> lock(st.mutex);
+            job.tile_seconds += std::chrono::duration<double>(tile_end - tile_start).count();
+            job.traversal.rays += after.rays - before.rays;
+            job.traversal.nodes_visited += after.nodes_visited - before.nodes_visited;
+            job.traversal.primitive_tests += after.primitive_tests - before.primitive_tests;
+            st.first_start = std::min(st.first_start, tile_start);
+            st.last_end = std::max(st.last_end, tile_end);
+        }
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        ++tiles_done;
+        std::cerr << "Tiles remaining: " << tasks.size() - tiles_done << "    \r";
+    });
+    double total_seconds = std::chrono::duration<double>(clock::now() - start).count();
+    std::cerr << "Done in " << total_seconds << " s.          \n";
+
+    bool ok = true;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        RenderJob& job = jobs[j];
+        JobState& st = *state[j];
+        job.seconds = std::chrono::duration<double>(st.last_end - st.first_start).count();
+        const double rays = static_cast<double>(job.traversal.rays);
+        std::cerr << "Job " << j + 1 << " (line " << job.line << "): " << job.settings.image_width << 'x'
+                  << job.settings.image_height << ", " << job.settings.samples_per_pixel << " spp, "
+                  << job.seconds << " s, " << rays / 1e6 << " Mrays, "
+                  << (job.tile_seconds > 0 ? rays / job.tile_seconds / 1e6 : 0.0) << " Mrays/s per thread\n";
+        for (const std::string& path : job.outputs) {
+            if (write_image(st.framebuffer, path, 1.0 / std::max(job.settings.samples_per_pixel, 1))) {
+                std::cerr << "Wrote " << path << '\n';
+            } else {
+                std::cerr << "Could not write " << path << '\n';
+                ok = false;
+            }
+        }
+    }
+    if (write_job_report(report_path, jobs, total_seconds)) std::cerr << "Wrote " << report_path << '\n';
+    else std::cerr << "Could not write " << report_path << '\n';
+    return ok;
+}
@@ -1,29 +1,102 @@
 #pragma once
 #include "hittable.h"
-#include "hittable_list.h"
-#include "rectangle.h"
+#include "flat_rects.h"
+#include <limits>
+#include <utility>
 
-class Box : public Hittable {
+// Axis-aligned box intersected analytically: one slab test gives the entry and exit
+// distances and the face that was crossed, with no per-face objects.
+class Box final : public Hittable {
 public:
     Vec3 box_min, box_max;
-    HittableList sides;
+    MaterialId mat_id = 0;
 
     Box() {}
-    Box(const Vec3& p0, const Vec3& p1, std::shared_ptr<Material> ptr) {
-        box_min = p0;
-        box_max = p1;
+    Box(const Vec3& p0, const Vec3& p1, MaterialId mat) : box_min(p0), box_max(p1), mat_id(mat) {}
 
-        sides.add(std::make_shared<XYRect>(p0.x, p1.x, p0.y, p1.y, p1.z, ptr));
-        sides.add(std::make_shared<XYRect>(p0.x, p1.x, p0.y, p1.y, p0.z, ptr));
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
+        Real t;
+        int axis;
+        bool max_side;
+        if (!nearest_face(r, t_min, t_max, t, axis, max_side)) return false;
 
-        sides.add(std::make_shared<XZRect>(p0.x, p1.x, p0.z, p1.z, p1.y, ptr));
-        sides.add(std::make_shared<XZRect>(p0.x, p1.x, p0.z, p1.z, p0.y, ptr));
+        const Real face = max_side ? coord(box_max, axis) : coord(box_min, axis);
+        rec.t = t;
+        rec.p = r.at(t);
+        // Exactly on the face plane, like the rects
+        if (axis == 0) rec.p.x = face;
+        else if (axis == 1) rec.p.y = face;
+        else rec.p.z = face;
+        const Real sign = max_side ? 1 : -1;
+        rec.set_face_normal(r, Vec3(axis == 0 ? sign : 0, axis == 1 ? sign : 0, axis == 2 ? sign : 0));
+        rec.mat_id = mat_id;
+        return true;
+    }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        Real t;
+        int axis;
+        bool max_side;
+        return nearest_face(r, t_min, t_max, t, axis, max_side);
+    }
 
-        sides.add(std::make_shared<YZRect>(p0.y, p1.y, p0.z, p1.z, p1.x, ptr));
-        sides.add(std::make_shared<YZRect>(p0.y, p1.y, p0.z, p1.z, p0.x, ptr));
+    virtual AABB bounding_box() const override {
+        return AABB(box_min, box_max);
     }
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override {
-        return sides.hit(r, t_min, t_max, rec);
+    // The six faces as rects, for the light list when the box is emissive
+    FlatRectSet faces() const {
+        FlatRectSet sides;
+        sides.add(XYRect(box_min.x, box_max.x, box_min.y, box_max.y, box_max.z, mat_id));
+        sides.add(XYRect(box_min.x, box_max.x, box_min.y, box_max.y, box_min.z, mat_id));
+        sides.add(XZRect(box_min.x, box_max.x, box_min.z, box_max.z, box_max.y, mat_id));
+        sides.add(XZRect(box_min.x, box_max.x, box_min.z, box_max.z, box_min.y, mat_id));
+        sides.add(YZRect(box_min.y, box_max.y, box_min.z, box_max.z, box_max.x, mat_id));
+        sides.add(YZRect(box_min.y, box_max.y, box_min.z, box_max.z, box_min.x, mat_id));
+        return sides;
+    }
+
+private:
+    static Real coord(const Vec3& v, int axis) { return axis == 0 ? v.x : axis == 1 ? v.y : v.z; }
+
+    // Nearest crossing of the box surface in [t_min, t_max]: the entry face, or the
+    // exit face when the entry lies outside the interval (ray starting inside).
+    bool nearest_face(const Ray& r, Real t_min, Real t_max, Real& t, int& axis, bool& max_side) const {
+        Real t_enter = -std::numeric_limits<Real>::infinity(), t_exit = std::numeric_limits<Real>::infinity();
+        int enter_axis = -1, exit_axis = -1;
+        bool enter_max = false, exit_max = false;
+        const Real origin[3] = {r.orig.x, r.orig.y, r.orig.z};
+        const Real dir[3] = {r.dir.x, r.dir.y, r.dir.z};
+        const Real box_lo[3] = {box_min.x, box_min.y, box_min.z};
+        const Real box_hi[3] = {box_max.x, box_max.y, box_max.z};
+        for (int a = 0; a < 3; ++a) {
+            const Real o = origin[a], d = dir[a], lo = box_lo[a], hi = box_hi[a];
+            if (d == 0) {
+                // Parallel to this slab: inside it for every t, or never
+                if (o < lo || o > hi) return false;
+                continue;
+            }
+            const Real inv_d = 1 / d;
+            Real t0 = (lo - o) * inv_d, t1 = (hi - o) * inv_d;
+            // Entering through the min face when moving towards +axis
+            const bool near_max = d < 0;
+            if (near_max) std::swap(t0, t1);
+            if (t0 > t_enter) { t_enter = t0; enter_axis = a; enter_max = near_max; }
+            if (t1 < t_exit) { t_exit = t1; exit_axis = a; exit_max = !near_max; }
+        }
+        if (t_enter > t_exit) return false;
+        if (t_enter >= t_min && t_enter <= t_max && enter_axis >= 0) {
+            t = t_enter;
+            axis = enter_axis;
+            max_side = enter_max;
+            return true;
+        }
+        if (t_exit >= t_min && t_exit <= t_max && exit_axis >= 0) {
+            t = t_exit;
+            axis = exit_axis;
+            max_side = exit_max;
+            return true;
+        }
+        return false;
     }
-}; 
\ No newline at end of file
+};
@@ -0,0 +1,435 @@
+#pragma once
+#include "hittable.h"
+#include "hittable_list.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+struct BVHBuildStats {
+    size_t primitives = 0;
+    size_t nodes = 0;
+    size_t leaves = 0;
+    int max_depth = 0;
+    double build_ms = 0.0;
+};
+
+struct BVHTraversalStats {
+    uint64_t rays = 0;
+    uint64_t nodes_visited = 0;
+    uint64_t primitive_tests = 0;
+};
+
+namespace bvh_detail {
+    // Totais globais; cada thread acumula localmente e só descarrega aqui ao terminar.
+    inline std::atomic<uint64_t> total_rays{0};
+    inline std::atomic<uint64_t> total_nodes_visited{0};
+    inline std::atomic<uint64_t> total_primitive_tests{0};
+
+    struct ThreadCounters {
+        BVHTraversalStats stats;
+        ~ThreadCounters() { flush(); }
+        void flush() {
+            total_rays += stats.rays;
+            total_nodes_visited += stats.nodes_visited;
+            total_primitive_tests += stats.primitive_tests;
+            stats = BVHTraversalStats();
+        }
+    };
+    inline thread_local ThreadCounters thread_counters;
+}
+
+// Flat depth-first node: interior nodes keep their left child right after them.
+// Plain data, so a node array can be written to disk and mapped back as is.
+struct BVHNode {
+    AABB bounds;
+    int32_t offset;  // leaf: first index into the primitive order; interior: index of the right child
+    int32_t count;   // number of primitives, 0 for interior nodes
+};
+static_assert(std::is_trivially_copyable<BVHNode>::value, "BVHNode is stored in scene caches");
+
+// Closest-hit traversal of a node array, shared by BVH and the compiled scene
+// cache. hit_primitive(i, t_max, rec) tests the i-th primitive in leaf order.
+// Visits the nearer child first and skips any subtree whose entry distance is
+// already beyond the closest hit found so far.
+template <typename HitPrimitive>
+inline bool bvh_traverse(const BVHNode* nodes, size_t node_count, const Ray& r, Real t_min, Real t_max,
+                         HitRecord& rec, const HitPrimitive& hit_primitive) {
+    BVHTraversalStats& counters = bvh_detail::thread_counters.stats;
+    ++counters.rays;
+    if (node_count == 0) return false;
+
+    const Vec3 origin = r.origin();
+    const Vec3 inv_dir(1.0 / r.direction().x, 1.0 / r.direction().y, 1.0 / r.direction().z);
+
+    Real t_root;
+    if (!nodes[0].bounds.hit(origin, inv_dir, t_min, t_max, t_root))
+        return false;
+
+    struct StackEntry { int node; Real t_entry; };
+    StackEntry stack[64];
+    int stack_size = 0;
+
+    HitRecord temp_rec;
+    bool hit_anything = false;
+    Real closest_so_far = t_max;
+    int current = 0;
+
+    while (true) {
+        const BVHNode& node = nodes[current];
+        ++counters.nodes_visited;
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; ++i) {
+                ++counters.primitive_tests;
+                if (hit_primitive(node.offset + i, closest_so_far, temp_rec)) {
+                    hit_anything = true;
+                    closest_so_far = temp_rec.t;
+                    rec = temp_rec;
+                }
+            }
+        } else {
+            const int left = current + 1;
+            const int right = node.offset;
+            Real t_left, t_right;
+            bool hit_left = nodes[left].bounds.hit(origin, inv_dir, t_min, closest_so_far, t_left);
+            bool hit_right = nodes[right].bounds.hit(origin, inv_dir, t_min, closest_so_far, t_right);
+
+            if (hit_left && hit_right) {
+                // Front-to-back: descend into the nearer child, defer the other
+                if (t_right < t_left) {
+                    stack[stack_size++] = {left, t_left};
+                    current = right;
+                } else {
+                    stack[stack_size++] = {right, t_right};
+                    current = left;
+                }
+                continue;
+            }
+            if (hit_left)  { current = left;  continue; }
+            if (hit_right) { current = right; continue; }
+        }
+
+        // Pop the next deferred subtree that can still contain a closer hit
+        bool found = false;
+        while (stack_size > 0) {
+            StackEntry e = stack[--stack_size];
+            if (e.t_entry <= closest_so_far) {
+                current = e.node;
+                found = true;
+                break;
+            }
+        }
+        if (!found) break;
+    }
+    return hit_anything;
+}
+
+// Any-hit traversal for shadow rays: occluded_primitive(i) tests the i-th primitive
+// in leaf order and the walk stops at the first one that blocks the ray. No
+// front-to-back ordering, since any blocker ends it.
+template <typename OccludedPrimitive>
+inline bool bvh_occluded(const BVHNode* nodes, size_t node_count, const Ray& r, Real t_min, Real t_max,
+                         const OccludedPrimitive& occluded_primitive) {
+    BVHTraversalStats& counters = bvh_detail::thread_counters.stats;
+    ++counters.rays;
+    if (node_count == 0) return false;
+
+    const Vec3 origin = r.origin();
+    const Vec3 inv_dir(1.0 / r.direction().x, 1.0 / r.direction().y, 1.0 / r.direction().z);
+
+    Real t_entry;
+    if (!nodes[0].bounds.hit(origin, inv_dir, t_min, t_max, t_entry))
+        return false;
+
+    int stack[64];
+    int stack_size = 0;
+    int current = 0;
+
+    while (true) {
+        const BVHNode& node = nodes[current];
+        ++counters.nodes_visited;
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; ++i) {
+                ++counters.primitive_tests;
+                if (occluded_primitive(node.offset + i)) return true;
+            }
+        } else {
+            const int left = current + 1;
+            const int right = node.offset;
+            bool hit_left = nodes[left].bounds.hit(origin, inv_dir, t_min, t_max, t_entry);
+            bool hit_right = nodes[right].bounds.hit(origin, inv_dir, t_min, t_max, t_entry);
+            if (hit_left && hit_right) {
+                stack[stack_size++] = right;
+                current = left;
+                continue;
+            }
+            if (hit_left)  { current = left;  continue; }
+            if (hit_right) { current = right; continue; }
+        }
+
+        if (stack_size == 0) return false;
+        current = stack[--stack_size];
+    }
+}
+
+// Packet version of bvh_traverse() for primary ray packets. A node is first
+// culled against the packet's frustum, then slab-tested ray by ray in SIMD lanes;
+// the surviving rays form the mask that goes down the subtree (and to
+// hit_leaf(i, mask) at the leaves). hits.t[] is every ray's closest hit so far.
+template <typename HitLeaf>
+inline void bvh_traverse_packet(const BVHNode* nodes, size_t node_count, const RayPacket& packet, uint64_t active,
+                                PacketHits& hits, const HitLeaf& hit_leaf) {
+    BVHTraversalStats& counters = bvh_detail::thread_counters.stats;
+    counters.rays += static_cast<uint64_t>(__builtin_popcountll(active));
+    if (node_count == 0 || active == 0) return;
+
+    // Farthest closest-hit of the packet, for the frustum test; refreshed after leaves
+    auto packet_far = [&]() {
+        Real far = 0;
+        for (uint64_t m = active; m; m &= m - 1) far = std::max(far, hits.t[__builtin_ctzll(m)]);
+        return far;
+    };
+    Real far = packet_far();
+
+    struct StackEntry { int node; uint64_t mask; };
+    StackEntry stack[64];
+    int stack_size = 0;
+
+    Real t_entry;
+    uint64_t mask = packet.may_hit(nodes[0].bounds, far) ? packet_box_mask(packet, nodes[0].bounds, active, hits.t, t_entry) : 0;
+    int current = 0;
+
+    while (mask != 0) {
+        const BVHNode& node = nodes[current];
+        ++counters.nodes_visited;
+
+        if (node.count > 0) {
+            counters.primitive_tests += static_cast<uint64_t>(node.count) * __builtin_popcountll(mask);
+            for (int i = 0; i < node.count; ++i) hit_leaf(node.offset + i, mask);
+            far = packet_far();
+        } else {
+            const int left = current + 1;
+            const int right = node.offset;
+            Real t_left = 0, t_right = 0;
+            uint64_t mask_left = packet.may_hit(nodes[left].bounds, far)
+                                     ? packet_box_mask(packet, nodes[left].bounds, mask, hits.t, t_left) : 0;
+            uint64_t mask_right = packet.may_hit(nodes[right].bounds, far)
+                                      ? packet_box_mask(packet, nodes[right].bounds, mask, hits.t, t_right) : 0;
+
+            if (mask_left && mask_right) {
+                // Same order as the single-ray traversal, by the nearest entry in the packet
+                if (t_right < t_left) {
+                    stack[stack_size++] = {left, mask_left};
+                    current = right;
+                    mask = mask_right;
+                } else {
+                    stack[stack_size++] = {right, mask_right};
+                    current = left;
+                    mask = mask_left;
+                }
+                continue;
+            }
+            if (mask_left)  { current = left;  mask = mask_left;  continue; }
+            if (mask_right) { current = right; mask = mask_right; continue; }
+        }
+
+        // Deferred subtrees are re-tested: closer hits may have been found since
+        mask = 0;
+        while (stack_size > 0 && mask == 0) {
+            StackEntry e = stack[--stack_size];
+            if (packet.may_hit(nodes[e.node].bounds, far))
+                mask = packet_box_mask(packet, nodes[e.node].bounds, e.mask, hits.t, t_entry);
+            current = e.node;
+        }
+    }
+}
+
+// Bounding volume hierarchy over the objects of a HittableList, built once with a
+// binned surface area heuristic and stored as a flat depth-first node array.
+class BVH : public Hittable {
+public:
+    explicit BVH(const HittableList& list, int max_leaf_size = 2) : max_leaf_size(std::max(max_leaf_size, 1)) {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<BuildItem> items;
+        items.reserve(list.objects.size());
+        for (size_t i = 0; i < list.objects.size(); ++i) {
+            AABB box = list.objects[i]->bounding_box();
+            items.push_back({box, box.centroid(), i});
+        }
+
+        nodes.reserve(2 * items.size() + 1);
+        if (!items.empty())
+            build(list, items, 0, items.size(), 1);
+
+        stats.primitives = items.size();
+        stats.nodes = nodes.size();
+        stats.build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
+        return bvh_traverse(nodes.data(), nodes.size(), r, t_min, t_max, rec,
+                            [&](int i, Real closest, HitRecord& temp) { return ordered[i]->hit(r, t_min, closest, temp); });
+    }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        return bvh_occluded(nodes.data(), nodes.size(), r, t_min, t_max,
+                            [&](int i) { return ordered[i]->occluded(r, t_min, t_max); });
+    }
+
+    virtual void hit_packet(const RayPacket& packet, uint64_t active, PacketHits& hits) const override {
+        bvh_traverse_packet(nodes.data(), nodes.size(), packet, active, hits,
+                            [&](int i, uint64_t mask) { ordered[i]->hit_packet(packet, mask, hits); });
+    }
+
+    virtual AABB bounding_box() const override {
+        return nodes.empty() ? AABB() : nodes[0].bounds;
+    }
+
+    const BVHBuildStats& build_stats() const { return stats; }
+    const std::vector<BVHNode>& node_array() const { return nodes; }
+    // Index in the source list of each primitive, in leaf order
+    const std::vector<uint32_t>& primitive_order() const { return order; }
+
+    // Traversal counters summed over every thread that has finished, plus the caller's.
+    static BVHTraversalStats traversal_stats() {
+        bvh_detail::thread_counters.flush();
+        BVHTraversalStats s;
+        s.rays = bvh_detail::total_rays;
+        s.nodes_visited = bvh_detail::total_nodes_visited;
+        s.primitive_tests = bvh_detail::total_primitive_tests;
+        return s;
+    }
+
+    void print_build_stats(std::ostream& out) const {
+        out << "BVH: " << stats.primitives << " primitives, " << stats.nodes << " nodes, "
+            << stats.leaves << " leaves, depth " << stats.max_depth
+            << ", built in " << stats.build_ms << " ms\n";
+    }
+
+    static void print_traversal_stats(std::ostream& out) {
+        BVHTraversalStats s = traversal_stats();
+        double rays = s.rays > 0 ? static_cast<double>(s.rays) : 1.0;
+        out << "BVH traversal: " << s.rays << " rays, "
+            << s.nodes_visited / rays << " nodes/ray, "
+            << s.primitive_tests / rays << " primitive tests/ray\n";
+    }
+
+private:
+    struct BuildItem {
+        AABB box;
+        Vec3 centroid;
+        size_t index;
+    };
+
+    static constexpr int kBins = 16;
+    static constexpr int kMaxDepth = 64;  // bounds the traversal stack
+    static constexpr double kTraversalCost = 0.125;  // relative to one primitive test
+
+    int max_leaf_size;
+    std::vector<BVHNode> nodes;
+    std::vector<std::shared_ptr<Hittable>> ordered;
+    std::vector<uint32_t> order;
+    BVHBuildStats stats;
+
+    static double axis_value(const Vec3& v, int axis) {
+        return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+    }
+
+    int make_leaf(const HittableList& list, std::vector<BuildItem>& items, size_t begin, size_t end, const AABB& bounds) {
+        int index = static_cast<int>(nodes.size());
+        nodes.push_back({bounds, static_cast<int>(ordered.size()), static_cast<int>(end - begin)});
+        for (size_t i = begin; i < end; ++i) {
+            ordered.push_back(list.objects[items[i].index]);
+            order.push_back(static_cast<uint32_t>(items[i].index));
+        }
+        ++stats.leaves;
+        return index;
+    }
+
+    int build(const HittableList& list, std::vector<BuildItem>& items, size_t begin, size_t end, int depth) {
+        stats.max_depth = std::max(stats.max_depth, depth);
+
+        AABB bounds, centroid_bounds;
+        for (size_t i = begin; i < end; ++i) {
+            bounds.expand(items[i].box);
+            centroid_bounds.expand(items[i].centroid);
+        }
+
+        const size_t count = end - begin;
+        if (count <= static_cast<size_t>(max_leaf_size) || depth >= kMaxDepth)
+            return make_leaf(list, items, begin, end, bounds);
+
+        // Binned SAH: pick the axis/bin boundary with the lowest expected cost
+        int best_axis = -1;
+        int best_split = 0;
+        double best_cost = std::numeric_limits<double>::infinity();
+        const double parent_area = bounds.surface_area();
+
+        for (int axis = 0; axis < 3; ++axis) {
+            double cmin = axis_value(centroid_bounds.minimum, axis);
+            double cmax = axis_value(centroid_bounds.maximum, axis);
+            if (cmax - cmin <= 1e-12) continue;
+
+            AABB bin_bounds[kBins];
+            int bin_counts[kBins] = {0};
+            double scale = kBins / (cmax - cmin);
+            for (size_t i = begin; i < end; ++i) {
+                int b = std::min(kBins - 1, static_cast<int>((axis_value(items[i].centroid, axis) - cmin) * scale));
+                ++bin_counts[b];
+                bin_bounds[b].expand(items[i].box);
+            }
+
+            // Sweep from the right to get suffix areas, then from the left to evaluate costs
+            double right_area[kBins];
+            int right_count[kBins];
+            AABB acc;
+            int n = 0;
+            for (int b = kBins - 1; b > 0; --b) {
+                acc.expand(bin_bounds[b]);
+                n += bin_counts[b];
+                right_area[b] = acc.surface_area();
+                right_count[b] = n;
+            }
+            acc = AABB();
+            n = 0;
+            for (int b = 0; b < kBins - 1; ++b) {
+                acc.expand(bin_bounds[b]);
+                n += bin_counts[b];
+                if (n == 0 || right_count[b + 1] == 0) continue;
+                double cost = kTraversalCost +
+                    (acc.surface_area() * n + right_area[b + 1] * right_count[b + 1]) / parent_area;
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = b;
+                }
+            }
+        }
+
+        // No useful split (coincident centroids or a leaf is cheaper)
+        if (best_axis < 0 || best_cost >= static_cast<double>(count))
+            return make_leaf(list, items, begin, end, bounds);
+
+        double cmin = axis_value(centroid_bounds.minimum, best_axis);
+        double scale = kBins / (axis_value(centroid_bounds.maximum, best_axis) - cmin);
+        auto mid_it = std::partition(items.begin() + begin, items.begin() + end, [&](const BuildItem& item) {
+            int b = std::min(kBins - 1, static_cast<int>((axis_value(item.centroid, best_axis) - cmin) * scale));
+            return b <= best_split;
+        });
+        size_t mid = static_cast<size_t>(mid_it - items.begin());
+
+        int index = static_cast<int>(nodes.size());
+        nodes.push_back({bounds, 0, 0});
+        build(list, items, begin, mid, depth + 1);
+        int right = build(list, items, mid, end, depth + 1);
+        nodes[index].offset = right;
+        return index;
+    }
+};
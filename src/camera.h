@@ -20,7 +20,7 @@ public:
         lower_left_corner = origin - horizontal / 2 - vertical / 2 - Vec3(0, 0, focal_length);
     }
 
-    Camera(Vec3 lookfrom, Vec3 lookat, Vec3 vup, double vfov, double aspect_ratio) {
+    Camera(Vec3 lookfrom, Vec3 lookat, Vec3 vup, Real vfov, Real aspect_ratio) {
         auto theta = vfov * M_PI / 180;
         auto h = tan(theta / 2);
         auto viewport_height = 2.0 * h;
@@ -36,7 +36,15 @@ public:
         lower_left_corner = origin - horizontal / 2 - vertical / 2 - w;
     }
 
-    Ray get_ray(double s, double t) const {
+    Ray get_ray(Real s, Real t) const {
         return Ray(origin, lower_left_corner + s * horizontal + t * vertical - origin);
     }
-}; 
\ No newline at end of file
+};
+
+// Jittered primary ray through pixel (i, j), with j = 0 at the bottom row.
+// Consumes the first two dimensions of the current camera sample.
+inline Ray jittered_camera_ray(const Camera& cam, int i, int j, int image_width, int image_height, Sampler& sampler) {
+    auto u = (i + sampler.next_1d()) / (image_width - 1);
+    auto v = (j + sampler.next_1d()) / (image_height - 1);
+    return cam.get_ray(u, v);
+} 
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+#include "scene.h"
+#include "rectangle.h"
+#include "rotated_box.h"
+#include "material.h"
+#include <memory>
+
+// Cena padrão (Cornell box): main.cpp sem --scene e os benchmarks
+inline void build_cornell_box(Scene& scene) {
+    HittableList& world = scene.objects;
+
+    // Materials with adjusted light intensity
+    MaterialId red = scene.materials.add<Lambertian>(Vec3(0.65, 0.05, 0.05));
+    MaterialId white = scene.materials.add<Lambertian>(Vec3(0.73, 0.73, 0.73));
+    MaterialId green = scene.materials.add<Lambertian>(Vec3(0.12, 0.45, 0.15));
+    MaterialId light = scene.materials.add<DiffuseLight>(Vec3(18, 18, 18));
+
+    // Cornell box walls
+    world.add(std::make_shared<YZRect>(0, 555, 0, 555, 555, green));  // Left wall
+    world.add(std::make_shared<YZRect>(0, 555, 0, 555, 0, red));      // Right wall
+    world.add(std::make_shared<XZRect>(0, 555, 0, 555, 0, white));    // Floor
+    world.add(std::make_shared<XYRect>(0, 555, 0, 555, 555, white));  // Back wall
+    
+    // Ceiling with precise hole for light
+    world.add(std::make_shared<XZRect>(0, 210, 0, 555, 555, white));     // Left part
+    world.add(std::make_shared<XZRect>(346, 555, 0, 555, 555, white));   // Right part  
+    world.add(std::make_shared<XZRect>(210, 346, 0, 224, 555, white));   // Front part
+    world.add(std::make_shared<XZRect>(210, 346, 335, 555, 555, white)); // Back part
+    
+    // Light retângulo (emite apenas para baixo)
+    world.add(std::make_shared<XZRect>(213, 343, 227, 332, 554, light));
+
+    // Rotated boxes for better shadow display
+    world.add(std::make_shared<RotatedBox>(Vec3(130, 0, 65), Vec3(295, 165, 230), white, 15));   // Short box rotated 15°
+    world.add(std::make_shared<RotatedBox>(Vec3(265, 0, 295), Vec3(430, 330, 460), white, -18)); // Tall box rotated -18°
+}
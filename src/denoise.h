@@ -0,0 +1,171 @@
+#pragma once
+#include "aov.h"
+#include "image.h"
+#include "tile_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Edge-avoiding à-trous wavelet filter (--denoise), guided by the AOV buffers as in
+// Dammertz et al. 2010 and SVGF (Schied et al. 2017). The radiance is first divided
+// by the first-hit albedo, so only the smooth illumination is blurred and the
+// surface colours come back sharp. Each iteration is a 5x5 B3-spline kernel whose
+// taps are 2^i pixels apart, weighted down across
+//   - normals:   max(0, n_p . n_q)^sigma_normal
+//   - depth:     |z_p - z_q| against the local depth gradient times the offset
+//   - luminance: |l_p - l_q| against sigma_luminance standard deviations of p's noise
+// The variance is filtered along with the colour, so later, wider iterations only
+// smooth what is still noisy. Misses (normal 0) are left alone.
+
+struct DenoiseSettings {
+    int iterations = 5;            // footprint 1 + 4 * (2^iterations - 1) pixels
+    float sigma_luminance = 4.0f;
+    float sigma_normal = 128.0f;
+    float sigma_depth = 1.0f;
+    int tile_size = 32;
+};
+
+namespace denoise_detail {
+
+inline float luminance(const float* c) { return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2]; }
+
+// Albedo com canal ~0 não demodula aquele canal (miss, superfície preta)
+inline float demodulation(float albedo) { return albedo > 1e-3f ? albedo : 1.0f; }
+
+struct Image {
+    int width, height;
+    const float* normal;    // 3 per pixel
+    const float* depth;
+    const float* gradient;  // dz/dx, dz/dy per pixel
+};
+
+// One à-trous iteration over `tile`: `color`/`variance` in, `color_out`/`variance_out` out.
+inline void atrous_tile(const Image& img, const Tile& tile, int step, const DenoiseSettings& ds, const float* color,
+                        const float* variance, float* color_out, float* variance_out) {
+    static const float kernel[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+    const int w = img.width, h = img.height;
+    for (int y = tile.y0; y < tile.y1; ++y) {
+        for (int x = tile.x0; x < tile.x1; ++x) {
+            const size_t p = static_cast<size_t>(y) * w + x;
+            const float* np = &img.normal[3 * p];
+            if (np[0] == 0.0f && np[1] == 0.0f && np[2] == 0.0f) {
+                std::copy(&color[3 * p], &color[3 * p] + 3, &color_out[3 * p]);
+                variance_out[p] = variance[p];
+                continue;
+            }
+
+            // Desvio padrão de p a partir da variância pré-filtrada (3x3 gaussiano), como no SVGF
+            float v = 0.0f, vw = 0.0f;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int qx = x + dx, qy = y + dy;
+                    if (qx < 0 || qy < 0 || qx >= w || qy >= h) continue;
+                    const float k = (dx == 0 ? 0.5f : 0.25f) * (dy == 0 ? 0.5f : 0.25f);
+                    v += k * variance[static_cast<size_t>(qy) * w + qx];
+                    vw += k;
+                }
+            }
+            const float luminance_scale = 1.0f / (ds.sigma_luminance * std::sqrt(v / vw) + 1e-6f);
+            const float lp = luminance(&color[3 * p]);
+            const float zp = img.depth[p];
+            const float gx = img.gradient[2 * p], gy = img.gradient[2 * p + 1];
+            const float depth_epsilon = 1e-2f * zp;
+
+            float sum[3] = {0, 0, 0}, sum_w = 0.0f, sum_v = 0.0f;
+            for (int dy = -2; dy <= 2; ++dy) {
+                const int qy = y + dy * step;
+                if (qy < 0 || qy >= h) continue;
+                for (int dx = -2; dx <= 2; ++dx) {
+                    const int qx = x + dx * step;
+                    if (qx < 0 || qx >= w) continue;
+                    const size_t q = static_cast<size_t>(qy) * w + qx;
+                    float weight = kernel[std::abs(dx)] * kernel[std::abs(dy)];
+                    if (q != p) {
+                        const float* nq = &img.normal[3 * q];
+                        const float cos_n = np[0] * nq[0] + np[1] * nq[1] + np[2] * nq[2];
+                        if (cos_n <= 0.0f) continue;
+                        const float expected_dz = std::abs(gx * dx * step + gy * dy * step);
+                        const float e = std::abs(zp - img.depth[q]) / (ds.sigma_depth * expected_dz + depth_epsilon) +
+                                        std::abs(lp - luminance(&color[3 * q])) * luminance_scale;
+                        weight *= std::pow(cos_n, ds.sigma_normal) * std::exp(-e);
+                    }
+                    for (int c = 0; c < 3; ++c) sum[c] += weight * color[3 * q + c];
+                    sum_w += weight;
+                    sum_v += weight * weight * variance[q];
+                }
+            }
+            for (int c = 0; c < 3; ++c) color_out[3 * p + c] = sum[c] / sum_w;
+            variance_out[p] = sum_v / (sum_w * sum_w);
+        }
+    }
+}
+
+// Screen-space depth gradient, from the one-sided difference with the smaller step so
+// that silhouettes do not inflate it. 0 across misses.
+inline std::vector<float> depth_gradient(const AovBuffers& aovs) {
+    const int w = aovs.width, h = aovs.height;
+    std::vector<float> gradient(2 * aovs.pixel_count(), 0.0f);
+    auto z = [&](int x, int y) { return aovs.depth[static_cast<size_t>(y) * w + x]; };
+    // `before`/`after` are 0 outside the image and on misses
+    auto slope = [](float center, float before, float after) {
+        if (before <= 0.0f) return after > 0.0f ? after - center : 0.0f;
+        if (after <= 0.0f) return center - before;
+        return std::abs(center - before) < std::abs(after - center) ? center - before : after - center;
+    };
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const float c = z(x, y);
+            if (c <= 0.0f) continue;
+            const size_t p = static_cast<size_t>(y) * w + x;
+            gradient[2 * p] = slope(c, x > 0 ? z(x - 1, y) : 0.0f, x + 1 < w ? z(x + 1, y) : 0.0f);
+            gradient[2 * p + 1] = slope(c, y > 0 ? z(x, y - 1) : 0.0f, y + 1 < h ? z(x, y + 1) : 0.0f);
+        }
+    }
+    return gradient;
+}
+
+} // namespace denoise_detail
+
+// Denoises the radiance sums `color` (times `scale` = 1 / spp) and returns the mean
+// radiance (write it with scale 1). Every iteration is spread over the tiles with the
+// work-stealing scheduler; iterations run one after the other.
+inline Framebuffer denoise(const Framebuffer& color, double scale, const AovBuffers& aovs, const DenoiseSettings& ds,
+                           int num_threads) {
+    using namespace denoise_detail;
+    auto start = std::chrono::steady_clock::now();
+    const size_t n = color.pixel_count();
+    std::vector<float> illumination(3 * n), illumination_next(3 * n), variance(n), variance_next(n);
+    for (size_t p = 0; p < n; ++p) {
+        const float* a = &aovs.albedo.data[3 * p];
+        float d[3] = {demodulation(a[0]), demodulation(a[1]), demodulation(a[2])};
+        for (int c = 0; c < 3; ++c) illumination[3 * p + c] = static_cast<float>(color.data[3 * p + c] * scale) / d[c];
+        // A variância é da luminância da radiância: leva para a escala da iluminação
+        const float l = luminance(d);
+        variance[p] = aovs.variance[p] / (l * l);
+    }
+    const std::vector<float> gradient = depth_gradient(aovs);
+    const Image img = {color.width, color.height, aovs.normal.data.data(), aovs.depth.data(), gradient.data()};
+
+    std::vector<Tile> tiles = make_tiles(color.width, color.height, ds.tile_size);
+    WorkStealingScheduler scheduler(resolve_thread_count(num_threads));
+    for (int i = 0; i < ds.iterations; ++i) {
+        const int step = 1 << i;
+        scheduler.run(tiles.size(), [&](size_t t, int) {
+            atrous_tile(img, tiles[t], step, ds, illumination.data(), variance.data(), illumination_next.data(),
+                        variance_next.data());
+        });
+        illumination.swap(illumination_next);
+        variance.swap(variance_next);
+    }
+
+    Framebuffer result(color.width, color.height);
+    for (size_t p = 0; p < n; ++p) {
+        const float* a = &aovs.albedo.data[3 * p];
+        for (int c = 0; c < 3; ++c) result.data[3 * p + c] = illumination[3 * p + c] * demodulation(a[c]);
+    }
+    std::cerr << "Denoised (" << ds.iterations << " a-trous iterations) in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+    return result;
+}
@@ -0,0 +1,433 @@
+#pragma once
+#include "bvh.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "rectangle.h"
+#include "simd.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Flat ("compiled") representation of axis-aligned rectangles: every rect of one
+// orientation lives in structure-of-arrays form and is intersected several at a
+// time by a SIMD kernel instead of one virtual hit() per heap-allocated object.
+
+// Rects of one orientation. The plane is n = k, the extent is [a0, a1] x [b0, b1].
+// Arrays are padded to a multiple of kLanes with rects that can never be hit.
+struct RectArraySoA {
+    // Um bloco do kernel AVX2: 4 doubles ou 8 floats
+    static constexpr size_t kLanes = sizeof(Real) == sizeof(float) ? 8 : 4;
+
+    std::vector<Real> k, a0, a1, b0, b1;
+    std::vector<MaterialId> mats;
+    size_t count = 0;
+
+    void add(Real a0_, Real a1_, Real b0_, Real b1_, Real k_, MaterialId m) {
+        // Overwrite the first padding slot if there is one
+        if (count < k.size()) {
+            k[count] = k_; a0[count] = a0_; a1[count] = a1_; b0[count] = b0_; b1[count] = b1_;
+            mats[count] = m;
+        } else {
+            k.push_back(k_); a0.push_back(a0_); a1.push_back(a1_); b0.push_back(b0_); b1.push_back(b1_);
+            mats.push_back(m);
+        }
+        ++count;
+        while (k.size() % kLanes != 0) {
+            // Empty extent (a0 > a1): the range test rejects it for every ray
+            k.push_back(0); a0.push_back(1); a1.push_back(-1); b0.push_back(1); b1.push_back(-1);
+            mats.push_back(0);
+        }
+    }
+
+    size_t padded_size() const { return k.size(); }
+};
+
+// Ray expressed in the rect's frame: n = normal axis, a/b = in-plane axes.
+struct RectRay {
+    Real o_n, inv_d_n;
+    Real o_a, d_a;
+    Real o_b, d_b;
+};
+
+// Each kernel returns the index of the nearest rect with t in [t_min, t_max] (or -1)
+// and lowers t_max to its distance. All levels use the same arithmetic so they
+// produce bit-identical hits. The kAnyHit instantiation is the shadow-ray kernel:
+// it returns the first rect it finds (in the first block whose hit mask is not
+// empty) and leaves t_max alone.
+template <bool kAnyHit = false>
+inline int nearest_rect_scalar(const RectArraySoA& s, const RectRay& r, Real t_min, Real& t_max) {
+    int best = -1;
+    for (size_t i = 0; i < s.count; ++i) {
+        Real t = (s.k[i] - r.o_n) * r.inv_d_n;
+        if (!(t >= t_min && t <= t_max)) continue;
+        Real a = r.o_a + t * r.d_a;
+        Real b = r.o_b + t * r.d_b;
+        if (a < s.a0[i] || a > s.a1[i] || b < s.b0[i] || b > s.b1[i]) continue;
+        if constexpr (kAnyHit) return static_cast<int>(i);
+        t_max = t;
+        best = static_cast<int>(i);
+    }
+    return best;
+}
+
+#if defined(PT_HAVE_X86_SIMD) && defined(PT_FLOAT)
+// Float build: each block of 8 rects is two SSE registers or one AVX2 register.
+template <bool kAnyHit = false>
+inline int nearest_rect_sse2(const RectArraySoA& s, const RectRay& r, float t_min, float& t_max) {
+    const __m128 o_n = _mm_set1_ps(r.o_n), inv_d_n = _mm_set1_ps(r.inv_d_n);
+    const __m128 o_a = _mm_set1_ps(r.o_a), d_a = _mm_set1_ps(r.d_a);
+    const __m128 o_b = _mm_set1_ps(r.o_b), d_b = _mm_set1_ps(r.d_b);
+    const __m128 tmin = _mm_set1_ps(t_min);
+    int best = -1;
+
+    for (size_t i = 0; i < s.padded_size(); i += 8) {
+        const __m128 tmax = _mm_set1_ps(t_max);
+        int mask = 0;
+        for (int h = 0; h < 2; ++h) {
+            size_t j = i + 4 * h;
+            __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&s.k[j]), o_n), inv_d_n);
+            __m128 a = _mm_add_ps(o_a, _mm_mul_ps(t, d_a));
+            __m128 b = _mm_add_ps(o_b, _mm_mul_ps(t, d_b));
+            __m128 m = _mm_and_ps(_mm_cmpge_ps(t, tmin), _mm_cmple_ps(t, tmax));
+            m = _mm_and_ps(m, _mm_and_ps(_mm_cmpge_ps(a, _mm_loadu_ps(&s.a0[j])), _mm_cmple_ps(a, _mm_loadu_ps(&s.a1[j]))));
+            m = _mm_and_ps(m, _mm_and_ps(_mm_cmpge_ps(b, _mm_loadu_ps(&s.b0[j])), _mm_cmple_ps(b, _mm_loadu_ps(&s.b1[j]))));
+            mask |= _mm_movemask_ps(m) << (4 * h);
+        }
+        if constexpr (kAnyHit) {
+            if (mask) return static_cast<int>(i) + __builtin_ctz(mask);
+            continue;
+        }
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+            size_t idx = i + lane;
+            float t = (s.k[idx] - r.o_n) * r.inv_d_n;
+            if (t <= t_max) {
+                t_max = t;
+                best = static_cast<int>(idx);
+            }
+        }
+    }
+    return best;
+}
+
+template <bool kAnyHit = false>
+__attribute__((target("avx2")))
+inline int nearest_rect_avx2(const RectArraySoA& s, const RectRay& r, float t_min, float& t_max) {
+    const __m256 o_n = _mm256_set1_ps(r.o_n), inv_d_n = _mm256_set1_ps(r.inv_d_n);
+    const __m256 o_a = _mm256_set1_ps(r.o_a), d_a = _mm256_set1_ps(r.d_a);
+    const __m256 o_b = _mm256_set1_ps(r.o_b), d_b = _mm256_set1_ps(r.d_b);
+    const __m256 tmin = _mm256_set1_ps(t_min);
+    int best = -1;
+
+    for (size_t i = 0; i < s.padded_size(); i += 8) {
+        const __m256 tmax = _mm256_set1_ps(t_max);
+        __m256 t = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&s.k[i]), o_n), inv_d_n);
+        __m256 a = _mm256_add_ps(o_a, _mm256_mul_ps(t, d_a));
+        __m256 b = _mm256_add_ps(o_b, _mm256_mul_ps(t, d_b));
+        __m256 m = _mm256_and_ps(_mm256_cmp_ps(t, tmin, _CMP_GE_OQ), _mm256_cmp_ps(t, tmax, _CMP_LE_OQ));
+        m = _mm256_and_ps(m, _mm256_and_ps(_mm256_cmp_ps(a, _mm256_loadu_ps(&s.a0[i]), _CMP_GE_OQ),
+                                           _mm256_cmp_ps(a, _mm256_loadu_ps(&s.a1[i]), _CMP_LE_OQ)));
+        m = _mm256_and_ps(m, _mm256_and_ps(_mm256_cmp_ps(b, _mm256_loadu_ps(&s.b0[i]), _CMP_GE_OQ),
+                                           _mm256_cmp_ps(b, _mm256_loadu_ps(&s.b1[i]), _CMP_LE_OQ)));
+        int mask = _mm256_movemask_ps(m);
+        if constexpr (kAnyHit) {
+            if (mask) return static_cast<int>(i) + __builtin_ctz(mask);
+            continue;
+        }
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+            size_t idx = i + lane;
+            float t = (s.k[idx] - r.o_n) * r.inv_d_n;
+            if (t <= t_max) {
+                t_max = t;
+                best = static_cast<int>(idx);
+            }
+        }
+    }
+    return best;
+}
+#elif defined(PT_HAVE_X86_SIMD)
+// SSE2: 2 doubles per register, two registers per iteration -> 4 rects at a time.
+template <bool kAnyHit = false>
+inline int nearest_rect_sse2(const RectArraySoA& s, const RectRay& r, double t_min, double& t_max) {
+    const __m128d o_n = _mm_set1_pd(r.o_n), inv_d_n = _mm_set1_pd(r.inv_d_n);
+    const __m128d o_a = _mm_set1_pd(r.o_a), d_a = _mm_set1_pd(r.d_a);
+    const __m128d o_b = _mm_set1_pd(r.o_b), d_b = _mm_set1_pd(r.d_b);
+    const __m128d tmin = _mm_set1_pd(t_min);
+    int best = -1;
+
+    for (size_t i = 0; i < s.padded_size(); i += 4) {
+        const __m128d tmax = _mm_set1_pd(t_max);
+        int mask = 0;
+        for (int h = 0; h < 2; ++h) {
+            size_t j = i + 2 * h;
+            __m128d t = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(&s.k[j]), o_n), inv_d_n);
+            __m128d a = _mm_add_pd(o_a, _mm_mul_pd(t, d_a));
+            __m128d b = _mm_add_pd(o_b, _mm_mul_pd(t, d_b));
+            __m128d m = _mm_and_pd(_mm_cmpge_pd(t, tmin), _mm_cmple_pd(t, tmax));
+            m = _mm_and_pd(m, _mm_and_pd(_mm_cmpge_pd(a, _mm_loadu_pd(&s.a0[j])), _mm_cmple_pd(a, _mm_loadu_pd(&s.a1[j]))));
+            m = _mm_and_pd(m, _mm_and_pd(_mm_cmpge_pd(b, _mm_loadu_pd(&s.b0[j])), _mm_cmple_pd(b, _mm_loadu_pd(&s.b1[j]))));
+            mask |= _mm_movemask_pd(m) << (2 * h);
+        }
+        if constexpr (kAnyHit) {
+            if (mask) return static_cast<int>(i) + __builtin_ctz(mask);
+            continue;
+        }
+        // Hits are rare per block: resolve the survivors in scalar code
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+            size_t idx = i + lane;
+            double t = (s.k[idx] - r.o_n) * r.inv_d_n;
+            if (t <= t_max) {
+                t_max = t;
+                best = static_cast<int>(idx);
+            }
+        }
+    }
+    return best;
+}
+
+// AVX2: 4 doubles per register, two registers per iteration -> 8 rects at a time
+// (a trailing block of 4 uses a single register).
+template <bool kAnyHit = false>
+__attribute__((target("avx2")))
+inline int nearest_rect_avx2(const RectArraySoA& s, const RectRay& r, double t_min, double& t_max) {
+    const __m256d o_n = _mm256_set1_pd(r.o_n), inv_d_n = _mm256_set1_pd(r.inv_d_n);
+    const __m256d o_a = _mm256_set1_pd(r.o_a), d_a = _mm256_set1_pd(r.d_a);
+    const __m256d o_b = _mm256_set1_pd(r.o_b), d_b = _mm256_set1_pd(r.d_b);
+    const __m256d tmin = _mm256_set1_pd(t_min);
+    const size_t n = s.padded_size();
+    int best = -1;
+
+    for (size_t i = 0; i < n; i += 8) {
+        const __m256d tmax = _mm256_set1_pd(t_max);
+        const int halves = (i + 8 <= n) ? 2 : 1;
+        int mask = 0;
+        for (int h = 0; h < halves; ++h) {
+            size_t j = i + 4 * h;
+            __m256d t = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(&s.k[j]), o_n), inv_d_n);
+            __m256d a = _mm256_add_pd(o_a, _mm256_mul_pd(t, d_a));
+            __m256d b = _mm256_add_pd(o_b, _mm256_mul_pd(t, d_b));
+            __m256d m = _mm256_and_pd(_mm256_cmp_pd(t, tmin, _CMP_GE_OQ), _mm256_cmp_pd(t, tmax, _CMP_LE_OQ));
+            m = _mm256_and_pd(m, _mm256_and_pd(_mm256_cmp_pd(a, _mm256_loadu_pd(&s.a0[j]), _CMP_GE_OQ),
+                                               _mm256_cmp_pd(a, _mm256_loadu_pd(&s.a1[j]), _CMP_LE_OQ)));
+            m = _mm256_and_pd(m, _mm256_and_pd(_mm256_cmp_pd(b, _mm256_loadu_pd(&s.b0[j]), _CMP_GE_OQ),
+                                               _mm256_cmp_pd(b, _mm256_loadu_pd(&s.b1[j]), _CMP_LE_OQ)));
+            mask |= _mm256_movemask_pd(m) << (4 * h);
+        }
+        if constexpr (kAnyHit) {
+            if (mask) return static_cast<int>(i) + __builtin_ctz(mask);
+            continue;
+        }
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+            size_t idx = i + lane;
+            double t = (s.k[idx] - r.o_n) * r.inv_d_n;
+            if (t <= t_max) {
+                t_max = t;
+                best = static_cast<int>(idx);
+            }
+        }
+    }
+    return best;
+}
+#endif
+
+inline int nearest_rect(const RectArraySoA& s, const RectRay& r, Real t_min, Real& t_max) {
+    if (s.count == 0) return -1;
+#ifdef PT_HAVE_X86_SIMD
+    switch (active_simd_level()) {
+        case SimdLevel::AVX2: return nearest_rect_avx2(s, r, t_min, t_max);
+        case SimdLevel::SSE2: return nearest_rect_sse2(s, r, t_min, t_max);
+        default: break;
+    }
+#endif
+    return nearest_rect_scalar(s, r, t_min, t_max);
+}
+
+// True if any rect has t in [t_min, t_max]: nearest_rect() without the search for
+// the minimum, for shadow rays
+inline bool any_rect(const RectArraySoA& s, const RectRay& r, Real t_min, Real t_max) {
+    if (s.count == 0) return false;
+#ifdef PT_HAVE_X86_SIMD
+    switch (active_simd_level()) {
+        case SimdLevel::AVX2: return nearest_rect_avx2<true>(s, r, t_min, t_max) >= 0;
+        case SimdLevel::SSE2: return nearest_rect_sse2<true>(s, r, t_min, t_max) >= 0;
+        default: break;
+    }
+#endif
+    return nearest_rect_scalar<true>(s, r, t_min, t_max) >= 0;
+}
+
+// Packet version of nearest_rect() for primary ray packets: the rays of the packet
+// in SIMD lanes, the rects one at a time. n/a/b are the axes (0 = x) of the rect
+// frame. For every active ray best[i] gets the nearest rect with t in [0, t_max[i]]
+// and t_max[i] its distance; rays without a hit keep both. Same rule as the
+// single-ray kernels, so every ray picks the same rect.
+__attribute__((always_inline))
+inline void nearest_rect_packet_lanes(const RectArraySoA& s, const RayPacket& p, int n, int a, int b,
+                                      uint64_t active, Real* t_max, int* best) {
+    const Real* dir[3] = {p.dx, p.dy, p.dz};
+    const Real* inv[3] = {p.inv_dx, p.inv_dy, p.inv_dz};
+    const Real o[3] = {p.origin.x, p.origin.y, p.origin.z};
+    const PacketLanes zero = PacketLanes{} + Real(0);
+    const PacketLanes o_a = zero + o[a], o_b = zero + o[b];
+
+    for (int i = 0; i < p.padded(); i += kPacketLanes) {
+        if ((active & lane_bits(i)) == 0) continue;
+        const PacketLanes inv_d_n = *reinterpret_cast<const PacketLanes*>(&inv[n][i]);
+        const PacketLanes d_a = *reinterpret_cast<const PacketLanes*>(&dir[a][i]);
+        const PacketLanes d_b = *reinterpret_cast<const PacketLanes*>(&dir[b][i]);
+        PacketLanes tmax = *reinterpret_cast<const PacketLanes*>(&t_max[i]);
+        PacketLanes hit = zero - 1;  // index of the nearest rect, as Real
+        for (size_t r = 0; r < s.count; ++r) {
+            PacketLanes t = (zero + (s.k[r] - o[n])) * inv_d_n;
+            PacketLanes pa = o_a + t * d_a;
+            PacketLanes pb = o_b + t * d_b;
+            auto m = (t >= zero) & (t <= tmax) & (pa >= s.a0[r]) & (pa <= s.a1[r]) & (pb >= s.b0[r]) & (pb <= s.b1[r]);
+            tmax = m ? t : tmax;
+            hit = m ? zero + Real(r) : hit;
+        }
+        // Padding and inactive lanes are computed too, but never written back
+        for (int l = 0; l < kPacketLanes; ++l) {
+            if (((active >> (i + l)) & 1) && hit[l] >= 0) {
+                t_max[i + l] = tmax[l];
+                best[i + l] = static_cast<int>(hit[l]);
+            }
+        }
+    }
+}
+
+#ifdef PT_HAVE_X86_SIMD
+__attribute__((target("avx2")))
+inline void nearest_rect_packet_avx2(const RectArraySoA& s, const RayPacket& p, int n, int a, int b,
+                                     uint64_t active, Real* t_max, int* best) {
+    nearest_rect_packet_lanes(s, p, n, a, b, active, t_max, best);
+}
+#endif
+
+inline void nearest_rect_packet(const RectArraySoA& s, const RayPacket& p, int n, int a, int b,
+                                uint64_t active, Real* t_max, int* best) {
+    if (s.count == 0) return;
+#ifdef PT_HAVE_X86_SIMD
+    if (active_simd_level() == SimdLevel::AVX2) return nearest_rect_packet_avx2(s, p, n, a, b, active, t_max, best);
+#endif
+    nearest_rect_packet_lanes(s, p, n, a, b, active, t_max, best);
+}
+
+class FlatRectSet final : public Hittable {
+public:
+    static constexpr int kChunkRects = 8;   // rects por conjunto em flatten_rects(): um bloco AVX2
+
+    RectArraySoA xy;  // n = z, a = x, b = y
+    RectArraySoA xz;  // n = y, a = x, b = z
+    RectArraySoA yz;  // n = x, a = y, b = z
+
+    void add(const XYRect& r) { xy.add(r.x0, r.x1, r.y0, r.y1, r.k, r.mat_id); bbox.expand(r.bounding_box()); }
+    void add(const XZRect& r) { xz.add(r.x0, r.x1, r.z0, r.z1, r.k, r.mat_id); bbox.expand(r.bounding_box()); }
+    void add(const YZRect& r) { yz.add(r.y0, r.y1, r.z0, r.z1, r.k, r.mat_id); bbox.expand(r.bounding_box()); }
+
+    size_t size() const { return xy.count + xz.count + yz.count; }
+
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
+        const Vec3& o = r.orig;
+        const Vec3& d = r.dir;
+
+        int best_xy = nearest_rect(xy, {o.z, 1 / d.z, o.x, d.x, o.y, d.y}, t_min, t_max);
+        int best_xz = nearest_rect(xz, {o.y, 1 / d.y, o.x, d.x, o.z, d.z}, t_min, t_max);
+        int best_yz = nearest_rect(yz, {o.x, 1 / d.x, o.y, d.y, o.z, d.z}, t_min, t_max);
+
+        // t_max only decreases, so the last orientation with a hit holds the nearest one
+        if (best_yz >= 0) return fill(r, t_max, 0, yz.k[best_yz], yz.mats[best_yz], rec);
+        if (best_xz >= 0) return fill(r, t_max, 1, xz.k[best_xz], xz.mats[best_xz], rec);
+        if (best_xy >= 0) return fill(r, t_max, 2, xy.k[best_xy], xy.mats[best_xy], rec);
+        return false;
+    }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        const Vec3& o = r.orig;
+        const Vec3& d = r.dir;
+        // Any rect will do: no hit record, and the scan stops at the first blocker
+        return any_rect(xy, {o.z, 1 / d.z, o.x, d.x, o.y, d.y}, t_min, t_max) ||
+               any_rect(xz, {o.y, 1 / d.y, o.x, d.x, o.z, d.z}, t_min, t_max) ||
+               any_rect(yz, {o.x, 1 / d.x, o.y, d.y, o.z, d.z}, t_min, t_max);
+    }
+
+    virtual void hit_packet(const RayPacket& packet, uint64_t active, PacketHits& hits) const override {
+        int best[3][kMaxPacketRays];
+        for (auto& b : best) std::fill(b, b + kMaxPacketRays, -1);
+        // Same orientation order as hit(): the last one with a hit holds the nearest
+        nearest_rect_packet(xy, packet, 2, 0, 1, active, hits.t, best[0]);
+        nearest_rect_packet(xz, packet, 1, 0, 2, active, hits.t, best[1]);
+        nearest_rect_packet(yz, packet, 0, 1, 2, active, hits.t, best[2]);
+
+        HitRecord rec;
+        for (; active; active &= active - 1) {
+            int i = __builtin_ctzll(active);
+            Ray r = packet.ray(i);
+            if (best[2][i] >= 0) fill(r, hits.t[i], 0, yz.k[best[2][i]], yz.mats[best[2][i]], rec);
+            else if (best[1][i] >= 0) fill(r, hits.t[i], 1, xz.k[best[1][i]], xz.mats[best[1][i]], rec);
+            else if (best[0][i] >= 0) fill(r, hits.t[i], 2, xy.k[best[0][i]], xy.mats[best[0][i]], rec);
+            else continue;
+            hits.record(i, rec);
+        }
+    }
+
+    virtual AABB bounding_box() const override { return bbox; }
+
+private:
+    AABB bbox;
+
+    // The hit point is snapped onto the rect's plane (coordinate `axis` = k), like XYRect::hit().
+    static bool fill(const Ray& r, Real t, int axis, Real k, MaterialId mat, HitRecord& rec) {
+        rec.t = t;
+        rec.p = r.at(t);
+        if (axis == 0) rec.p.x = k;
+        else if (axis == 1) rec.p.y = k;
+        else rec.p.z = k;
+        rec.set_face_normal(r, Vec3(axis == 0 ? 1 : 0, axis == 1 ? 1 : 0, axis == 2 ? 1 : 0));
+        rec.mat_id = mat;
+        return true;
+    }
+};
+
+// Moves the top-level XYRect/XZRect/YZRect of a list into FlatRectSets of nearby
+// rects, one per leaf of a BVH built over the rects alone with up to `chunk_rects`
+// per leaf, and keeps the remaining objects as they are. Each set is one primitive
+// of the scene BVH, which can then still cull the rects: a single set for all of
+// them would be scanned linearly by every ray that reaches it.
+inline HittableList flatten_rects(const HittableList& list, int chunk_rects = FlatRectSet::kChunkRects) {
+    // Adds `object` to `set` if it is one of the flattened rect types
+    auto add_rect = [](FlatRectSet* set, const Hittable* object) {
+        if (auto r = dynamic_cast<const XYRect*>(object)) { if (set) set->add(*r); return true; }
+        if (auto r = dynamic_cast<const XZRect*>(object)) { if (set) set->add(*r); return true; }
+        if (auto r = dynamic_cast<const YZRect*>(object)) { if (set) set->add(*r); return true; }
+        return false;
+    };
+    HittableList rects, result;
+    for (const auto& object : list.objects) {
+        if (add_rect(nullptr, object.get())) rects.add(object);
+        else result.add(object);
+    }
+    if (rects.objects.empty()) return result;
+
+    BVH chunks(rects, chunk_rects);
+    const std::vector<uint32_t>& order = chunks.primitive_order();
+    for (const BVHNode& node : chunks.node_array()) {
+        if (node.count == 0) continue;
+        // Dentro de um conjunto, a ordem da lista (empates em t resolvem como antes)
+        std::vector<uint32_t> leaf(order.begin() + node.offset, order.begin() + node.offset + node.count);
+        std::sort(leaf.begin(), leaf.end());
+        auto flat = std::make_shared<FlatRectSet>();
+        for (uint32_t i : leaf) add_rect(flat.get(), rects.objects[i].get());
+        result.add(flat);
+    }
+    return result;
+}
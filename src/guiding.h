@@ -0,0 +1,52 @@
+#pragma once
+#include "path_tracer.h"
+#include "sd_tree.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// Path guiding (--guiding): up to `train_samples` samples per pixel are traced in
+// passes of 1, 2, 4, ... spp that record the incident radiance into an SD-tree
+// over the scene; after each pass the tree is refined and the next pass samples
+// the BSDF/tree mixture learned so far. The remaining samples are one final pass
+// that only samples the last tree. Every pass adds to `framebuffer` (the mixture
+// pdfs keep each one unbiased), so no sample is thrown away.
+// Returns the wall-clock time spent tracing and refining.
+inline double render_guided(const Scene& scene, const Camera& cam, const RenderSettings& settings, int train_samples,
+                            Framebuffer& framebuffer, AovBuffers* aovs = nullptr) {
+    framebuffer = Framebuffer(settings.image_width, settings.image_height);
+    if (aovs) *aovs = AovBuffers(settings.image_width, settings.image_height);
+    SDTree tree(scene.world().bounding_box());
+    RenderSettings guided = settings;
+    guided.guide = &tree;
+
+    const int target = settings.samples_per_pixel;
+    train_samples = std::clamp(train_samples, 0, target);
+    std::cerr << "Guided rendering on " << resolve_thread_count(settings.num_threads) << " threads, "
+              << "up to " << train_samples << " of " << target << " spp training\n";
+
+    double total_seconds = 0.0;
+    int done = 0;
+    // Uma passada curta no fim treinaria a última árvore com poucas amostras: o que
+    // não completa a próxima potência de 2 fica para a passada final
+    for (int n = 1; done + n <= train_samples; n *= 2) {
+        double seconds = render_pass(scene, cam, guided, framebuffer, done, n, aovs);
+        done += n;
+        auto refine_start = std::chrono::steady_clock::now();
+        tree.refine(n);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - refine_start).count();
+        total_seconds += seconds;
+        std::cerr << "Training pass done: " << done << " spp (" << n / seconds << " spp/s), " << tree.leaf_count()
+                  << " spatial leaves, " << tree.directional_node_count() << " directional nodes      \n";
+    }
+
+    tree.recording = false;
+    if (done < target) {
+        double seconds = render_pass(scene, cam, guided, framebuffer, done, target - done, aovs);
+        total_seconds += seconds;
+        std::cerr << "Final pass done: " << target << " spp (" << (target - done) / seconds << " spp/s)      \n";
+    }
+    if (aovs) aovs->finish(target);
+    std::cerr << "Done in " << total_seconds << " s.          \n";
+    return total_seconds;
+}
@@ -1,24 +1,76 @@
 #pragma once
 #include "ray.h"
-#include <memory>
+#include "aabb.h"
+#include "packet.h"
+#include <cstdint>
+#include <limits>
+#include <type_traits>
 
-class Material; // forward declaration
+// Índice na MaterialTable da cena (ver material.h)
+using MaterialId = uint32_t;
 
 struct HitRecord {
     Vec3 p;
     Vec3 normal;
-    std::shared_ptr<Material> mat_ptr;
-    double t;
+    MaterialId mat_id;
+    Real t;
     bool front_face;
 
     inline void set_face_normal(const Ray& r, const Vec3& outward_normal) {
         front_face = dot(r.direction(), outward_normal) < 0;
         normal = front_face ? outward_normal : -outward_normal;
     }
+
+    // Ray leaving the hit point toward `dir`, started off the surface on the side
+    // `dir` points to (see offset_ray_origin), so it can be traced from t = 0.
+    inline Ray spawn_ray(const Vec3& dir) const {
+        return Ray(offset_ray_origin(p, dot(dir, normal) > 0 ? normal : -normal), dir);
+    }
+};
+
+// Copied on every closer hit in the innermost loops: keep it a plain struct.
+static_assert(std::is_trivially_copyable<HitRecord>::value, "HitRecord must stay trivially copyable");
+
+// Closest hits of a RayPacket. t[i] doubles as the t_max of ray i, so one packet
+// can be passed through several objects like a ray through a HittableList.
+struct PacketHits {
+    alignas(32) Real t[kMaxPacketRays];
+    HitRecord rec[kMaxPacketRays];
+    uint64_t mask = 0;  // rays with a hit
+
+    void reset() {
+        for (Real& ti : t) ti = std::numeric_limits<Real>::infinity();
+        mask = 0;
+    }
+
+    void record(int i, const HitRecord& r) {
+        rec[i] = r;
+        t[i] = r.t;
+        mask |= uint64_t(1) << i;
+    }
 };
 
 class Hittable {
 public:
     virtual ~Hittable() {}
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const = 0;
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const = 0;
+    virtual AABB bounding_box() const = 0;
+
+    // Any-hit query for shadow rays: true if something lies in [t_min, t_max].
+    // Overrides stop at the first blocker and skip the HitRecord.
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const {
+        HitRecord rec;
+        return hit(r, t_min, t_max, rec);
+    }
+
+    // Closest hits (t_min = 0) of the packet rays set in `active`. The default traces
+    // them one by one; BVH, HittableList and FlatRectSet handle the packet as a whole.
+    virtual void hit_packet(const RayPacket& packet, uint64_t active, PacketHits& hits) const {
+        HitRecord rec;
+        while (active) {
+            int i = __builtin_ctzll(active);
+            active &= active - 1;
+            if (hit(packet.ray(i), 0, hits.t[i], rec)) hits.record(i, rec);
+        }
+    }
 }; 
\ No newline at end of file
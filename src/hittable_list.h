@@ -13,10 +13,10 @@ public:
     void clear() { objects.clear(); }
     void add(std::shared_ptr<Hittable> object) { objects.push_back(object); }
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override {
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
         HitRecord temp_rec;
         bool hit_anything = false;
-        double closest_so_far = t_max;
+        Real closest_so_far = t_max;
 
         for (const auto& object : objects) {
             if (object->hit(r, t_min, closest_so_far, temp_rec)) {
@@ -27,4 +27,22 @@ public:
         }
         return hit_anything;
     }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        for (const auto& object : objects)
+            if (object->occluded(r, t_min, t_max)) return true;
+        return false;
+    }
+
+    virtual void hit_packet(const RayPacket& packet, uint64_t active, PacketHits& hits) const override {
+        for (const auto& object : objects)
+            object->hit_packet(packet, active, hits);
+    }
+
+    virtual AABB bounding_box() const override {
+        AABB box;
+        for (const auto& object : objects)
+            box.expand(object->bounding_box());
+        return box;
+    }
 }; 
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+#include "vec3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Linear radiance accumulated by the renderer, 3 floats per pixel, row 0 = top of
+// the image. Nothing is quantized or gamma corrected until an image is written.
+class Framebuffer {
+public:
+    int width = 0;
+    int height = 0;
+    std::vector<float> data;
+
+    Framebuffer() {}
+    Framebuffer(int w, int h) : width(w), height(h), data(static_cast<size_t>(w) * h * 3, 0.0f) {}
+
+    size_t pixel_count() const { return static_cast<size_t>(width) * height; }
+
+    void add(size_t pixel, const Vec3& c) {
+        float* p = &data[3 * pixel];
+        p[0] += static_cast<float>(c.x);
+        p[1] += static_cast<float>(c.y);
+        p[2] += static_cast<float>(c.z);
+    }
+
+    void set(size_t pixel, const Vec3& c) {
+        float* p = &data[3 * pixel];
+        p[0] = static_cast<float>(c.x);
+        p[1] = static_cast<float>(c.y);
+        p[2] = static_cast<float>(c.z);
+    }
+
+    Vec3 get(size_t pixel) const {
+        const float* p = &data[3 * pixel];
+        return Vec3(p[0], p[1], p[2]);
+    }
+};
+
+// Binary PPM (P6): radiance * scale, gamma 2 (sqrt), 8 bits per channel. A
+// non-empty `comment` goes into the header as a "# ..." line (e.g. the spp).
+inline bool write_ppm(const Framebuffer& fb, const std::string& path, double scale, const std::string& comment = "") {
+    std::vector<unsigned char> bytes(fb.pixel_count() * 3);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        double c = std::sqrt(std::max(0.0, fb.data[i] * scale));
+        bytes[i] = static_cast<unsigned char>(256 * std::clamp(c, 0.0, 0.999));
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    out << "P6\n";
+    if (!comment.empty()) out << "# " << comment << '\n';
+    out << fb.width << ' ' << fb.height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(out);
+}
+
+inline bool host_is_little_endian() {
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+}
+
+// Portable float map (PF): linear radiance * scale, 32-bit floats. The negative
+// scale in the header marks little-endian data; PFM stores rows bottom to top.
+inline bool write_pfm(const Framebuffer& fb, const std::string& path, double scale) {
+    std::vector<float> rows(fb.data.size());
+    const size_t row_floats = static_cast<size_t>(fb.width) * 3;
+    for (int y = 0; y < fb.height; ++y) {
+        const float* src = &fb.data[static_cast<size_t>(fb.height - 1 - y) * row_floats];
+        float* dst = &rows[static_cast<size_t>(y) * row_floats];
+        for (size_t i = 0; i < row_floats; ++i)
+            dst[i] = static_cast<float>(src[i] * scale);
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    out << "PF\n" << fb.width << ' ' << fb.height << '\n' << (host_is_little_endian() ? "-1.0" : "1.0") << '\n';
+    out.write(reinterpret_cast<const char*>(rows.data()), static_cast<std::streamsize>(rows.size() * sizeof(float)));
+    return static_cast<bool>(out);
+}
+
+// Reads a colour PFM written by write_pfm() (or any PF file) into `fb`, row 0 = top.
+inline bool read_pfm(const std::string& path, Framebuffer& fb) {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int width = 0, height = 0;
+    double scale = 0.0;
+    if (!(in >> magic >> width >> height >> scale) || magic != "PF" || width <= 0 || height <= 0) return false;
+    in.get();   // the single whitespace before the data
+    std::vector<float> rows(static_cast<size_t>(width) * height * 3);
+    if (!in.read(reinterpret_cast<char*>(rows.data()), static_cast<std::streamsize>(rows.size() * sizeof(float))))
+        return false;
+    if ((scale < 0.0) != host_is_little_endian()) {
+        for (float& f : rows) {
+            unsigned char* b = reinterpret_cast<unsigned char*>(&f);
+            std::swap(b[0], b[3]);
+            std::swap(b[1], b[2]);
+        }
+    }
+    fb = Framebuffer(width, height);
+    const size_t row_floats = static_cast<size_t>(width) * 3;
+    for (int y = 0; y < height; ++y)
+        std::copy_n(&rows[static_cast<size_t>(height - 1 - y) * row_floats], row_floats, &fb.data[static_cast<size_t>(y) * row_floats]);
+    return true;
+}
+
+// Root mean square error of `fb` * scale against `reference`, over all channels
+// (the same number as bench/image_diff.py). Negative if the sizes differ.
+inline double image_rmse(const Framebuffer& fb, double scale, const Framebuffer& reference) {
+    if (fb.width != reference.width || fb.height != reference.height) return -1.0;
+    double sum = 0.0;
+    for (size_t i = 0; i < fb.data.size(); ++i) {
+        double d = fb.data[i] * scale - reference.data[i];
+        sum += d * d;
+    }
+    return std::sqrt(sum / std::max<size_t>(fb.data.size(), 1));
+}
+
+inline bool has_extension(const std::string& path, const std::string& ext) {
+    return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+// Picks the format from the extension: .pfm is HDR, everything else is P6. PFM
+// has no room for comments, so only P6 keeps `comment`.
+inline bool write_image(const Framebuffer& fb, const std::string& path, double scale, const std::string& comment = "") {
+    if (has_extension(path, ".pfm")) return write_pfm(fb, path, scale);
+    return write_ppm(fb, path, scale, comment);
+}
+
+// False-colour map of a per-pixel scalar (sample counts, tile cost, ...), row 0 = top.
+// .pfm keeps the raw values; other extensions get a P6 image normalized to the
+// maximum with a black -> blue -> red -> yellow -> white ramp.
+inline bool write_heatmap(const std::vector<float>& values, int width, int height, const std::string& path) {
+    if (has_extension(path, ".pfm")) {
+        Framebuffer fb(width, height);
+        for (size_t i = 0; i < values.size(); ++i) fb.set(i, Vec3(values[i], values[i], values[i]));
+        return write_pfm(fb, path, 1.0);
+    }
+
+    float max_value = 0.0f;
+    for (float v : values) max_value = std::max(max_value, v);
+    const double inv_max = max_value > 0.0f ? 1.0 / max_value : 0.0;
+
+    std::vector<unsigned char> bytes(values.size() * 3);
+    for (size_t i = 0; i < values.size(); ++i) {
+        double t = std::clamp(values[i] * inv_max, 0.0, 1.0);
+        double r = std::clamp(3.0 * t - 1.0, 0.0, 1.0);
+        double g = std::clamp(3.0 * t - 2.0, 0.0, 1.0);
+        double b = t < 1.0 / 3.0 ? 3.0 * t : std::clamp(2.0 - 3.0 * t, 0.0, 1.0) + g;
+        bytes[3 * i + 0] = static_cast<unsigned char>(255.0 * r);
+        bytes[3 * i + 1] = static_cast<unsigned char>(255.0 * g);
+        bytes[3 * i + 2] = static_cast<unsigned char>(255.0 * std::min(b, 1.0));
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    out << "P6\n" << width << ' ' << height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "hittable.h"
+#include "transform.h"
+#include <memory>
+
+// Hit of `object` placed by `transform`: the ray goes to object space, the hit
+// comes back. Same t in both spaces; the normal keeps its side of the ray under
+// the inverse transpose.
+template <typename Object>
+inline bool hit_instance(const Object& object, const Transform& transform, const Ray& r, Real t_min, Real t_max,
+                         HitRecord& rec) {
+    if (!object.hit(transform.ray_to_object(r), t_min, t_max, rec))
+        return false;
+    rec.p = transform.point_to_world(rec.p);
+    rec.normal = unit_vector(transform.normal_to_world(rec.normal));
+    return true;
+}
+
+// A placed copy of shared geometry: the object stays in its own space and the
+// instance only keeps the transform (both matrices precomputed) and world bounds.
+// Thousands of instances of one object cost one geometry allocation plus these
+// records.
+class Instance : public Hittable {
+public:
+    std::shared_ptr<const Hittable> object;
+    Transform transform;
+    AABB bbox;
+
+    Instance(std::shared_ptr<const Hittable> object, const Transform& transform)
+        : object(std::move(object)), transform(transform) {
+        bbox = transform.box_to_world(this->object->bounding_box());
+    }
+
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
+        return hit_instance(*object, transform, r, t_min, t_max, rec);
+    }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        return object->occluded(transform.ray_to_object(r), t_min, t_max);
+    }
+
+    virtual AABB bounding_box() const override {
+        return bbox;
+    }
+};
+
+// An Instance whose object is held by value with its concrete type, for closed
+// primitive sets (StaticScene): same results, but the object's hit() is a direct call.
+template <typename Object>
+struct TypedInstance {
+    Object object;
+    Transform transform;
+
+    TypedInstance(const Object& object, const Transform& transform) : object(object), transform(transform) {}
+
+    bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const {
+        return hit_instance(object, transform, r, t_min, t_max, rec);
+    }
+
+    bool occluded(const Ray& r, Real t_min, Real t_max) const {
+        return object.occluded(transform.ray_to_object(r), t_min, t_max);
+    }
+};
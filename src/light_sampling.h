@@ -0,0 +1,77 @@
+#pragma once
+#include "scene.h"
+#include "sampler.h"
+#include "render_stats.h"
+#include <cmath>
+
+// One next-event estimation sample: a light picked from the scene's light list
+// (power-weighted alias table) and a point on it.
+struct LightSample {
+    Vec3 Li;       // Emitted radiance divided by pdf (the BSDF * cos factor is applied by the caller)
+    Vec3 dir;      // Unit direction from the shading point to the light
+    double pdf;    // Pdf w.r.t. solid angle at the hit point, light selection included
+};
+
+// A light sample before its shadow ray is traced. The wavefront integrator queues
+// these and resolves visibility for the whole batch in a separate stage.
+struct LightSampleQuery {
+    Ray shadow_ray;
+    Real t_max;
+    LightSample unoccluded;
+    bool valid;    // false when the geometry terms already zero the contribution
+};
+
+// Consumes three sampler dimensions (light choice, point on the light).
+inline LightSampleQuery prepare_light_sample(const Vec3& hit_point, const Vec3& normal, const Scene& scene, Sampler& sampler) {
+    LightSampleQuery query;
+    query.t_max = 0.0;
+    query.unoccluded = {Vec3(0, 0, 0), Vec3(0, 0, 0), 0.0};
+    query.valid = false;
+    if (scene.lights.empty()) return query;
+
+    size_t index = scene.lights.table.sample(sampler.next_1d());
+    const AreaLight& light = scene.lights.lights[index];
+
+    // Sampled from the shadow ray's origin (off the surface), so `distance` is exactly
+    // how far that ray has to go
+    Vec3 origin = offset_ray_origin(hit_point, normal);
+    Vec3 light_dir;
+    Real distance;
+    double pdf_light;
+    if (!light.sample(origin, sampler, light_dir, distance, pdf_light, scene.lights.rect_sampling)) return query;
+    // Surfaces only receive light on the side their normal points to
+    if (dot(normal, light_dir) <= 0.0) return query;
+    pdf_light *= scene.lights.table.pmf[index];
+    if (!(pdf_light > 0.0) || !std::isfinite(pdf_light)) return query;
+
+    // Stops just short of the light, so the emitter itself does not count as a blocker
+    query.shadow_ray = Ray(origin, light_dir);
+    query.t_max = distance * (1 - shadow_ray_shortening<Real>());
+    query.unoccluded = {light.emission / pdf_light, light_dir, pdf_light};
+    query.valid = true;
+    return query;
+}
+
+// Shadow ray test: anything between the point and the light blocks it. Any-hit
+// query; the sampled emitter itself lies past t_max.
+inline bool light_visible(const LightSampleQuery& query, const Scene& scene) {
+    bool occluded = scene.world().occluded(query.shadow_ray, 0, query.t_max);
+    PT_STAT(++render_stats::local().shadow_rays);
+    PT_STAT(render_stats::local().shadow_occluded += occluded);
+    return !occluded;
+}
+
+// Returns a zero sample (Li = 0, pdf = 0) when the light is blocked or faces away.
+inline LightSample sample_light_direct(const Vec3& hit_point, const Vec3& normal, const Scene& scene, Sampler& sampler) {
+    LightSampleQuery query = prepare_light_sample(hit_point, normal, scene, sampler);
+    if (!query.valid || !light_visible(query, scene))
+        return {Vec3(0, 0, 0), query.unoccluded.dir, 0.0};
+    return query.unoccluded;
+}
+
+// Power heuristic for MIS
+inline double power_heuristic(double pdf_a, double pdf_b) {
+    double a = pdf_a * pdf_a;
+    double b = pdf_b * pdf_b;
+    return a + b > 0.0 ? a / (a + b) : 0.0;
+}
@@ -0,0 +1,366 @@
+#pragma once
+#include "hittable_list.h"
+#include "material.h"
+#include "rectangle.h"
+#include "sphere.h"
+#include "box.h"
+#include "flat_rects.h"
+#include "sampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Walker/Vose alias table: O(1) sampling of a discrete distribution with a single
+// uniform number.
+class AliasTable {
+public:
+    std::vector<double> prob;     // chance de ficar com a própria entrada
+    std::vector<uint32_t> alias;  // entrada usada caso contrário
+    std::vector<double> pmf;      // probabilidade normalizada de cada entrada
+
+    void build(const std::vector<double>& weights) {
+        const size_t n = weights.size();
+        prob.assign(n, 1.0);
+        alias.assign(n, 0);
+        pmf.assign(n, 0.0);
+        double total = 0.0;
+        for (double w : weights) total += std::max(w, 0.0);
+        if (n == 0) return;
+
+        std::vector<double> scaled(n);
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; ++i) {
+            pmf[i] = total > 0.0 ? std::max(weights[i], 0.0) / total : 1.0 / n;
+            scaled[i] = pmf[i] * n;
+            alias[i] = static_cast<uint32_t>(i);
+            (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            uint32_t s = small.back(); small.pop_back();
+            uint32_t l = large.back(); large.pop_back();
+            prob[s] = scaled[s];
+            alias[s] = l;
+            scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+            (scaled[l] < 1.0 ? small : large).push_back(l);
+        }
+        // Leftovers are 1 up to rounding
+        for (uint32_t i : small) prob[i] = 1.0;
+        for (uint32_t i : large) prob[i] = 1.0;
+    }
+
+    size_t size() const { return prob.size(); }
+
+    // u in [0,1): the integer part picks a column, the fraction decides between it and its alias.
+    size_t sample(double u) const {
+        const size_t n = prob.size();
+        double scaled = u * n;
+        size_t i = std::min(static_cast<size_t>(scaled), n - 1);
+        return (scaled - i) < prob[i] ? i : alias[i];
+    }
+};
+
+// How next-event estimation picks a point on a rectangular emitter (--light_sampling).
+// Area (default): uniform over the rect, pdf converted by distance^2 / (cos * A).
+// SolidAngle: uniform over the solid angle the rect subtends (SphericalRect below).
+enum class RectLightSampling { Area, SolidAngle };
+
+inline const char* rect_light_sampling_name(RectLightSampling mode) {
+    return mode == RectLightSampling::Area ? "area" : "solid_angle";
+}
+
+inline bool parse_rect_light_sampling(const char* name, RectLightSampling& mode) {
+    for (RectLightSampling m : {RectLightSampling::Area, RectLightSampling::SolidAngle}) {
+        if (strcmp(name, rect_light_sampling_name(m)) == 0) {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Spherical rectangle (Ureña, Fajardo & King 2013, "An Area-Preserving
+// Parametrization for Spherical Rectangles"): the rect [x0,x1] x [y0,y1] at height
+// z0 in a frame centred on the shading point, projected on the unit sphere. sample()
+// maps the unit square to it with constant density 1 / solid_angle.
+struct SphericalRect {
+    // Fora desta faixa de ângulo sólido (quase nada, ou quase um hemisfério) as contas
+    // perdem precisão: a luz volta à amostragem por área (mesmos limites do pbrt-v4)
+    static constexpr double kMinSolidAngle = 3e-4;
+    static constexpr double kMaxSolidAngle = 6.22;
+
+    double x0, x1, y0, y1, z0;
+    double b0, b1, k;
+    double solid_angle = 0.0;
+
+    SphericalRect(double x0, double x1, double y0, double y1, double z)
+        : x0(x0), x1(x1), y0(y0), y1(y1), z0(-std::fabs(z)) {
+        // Ângulos internos g0..g3 entre as normais das arestas (cross dos vértices
+        // vizinhos). Escritos por componente, cos(g) e sin(g) saem proporcionais a
+        // termos simples, e cada par g0 + g1, g2 + g3 vira um atan2 do produto complexo
+        // em vez de quatro acos.
+        const double z2 = z0 * z0, az = -z0;
+        const double r00 = std::sqrt(x0 * x0 + y0 * y0 + z2), r10 = std::sqrt(x1 * x1 + y0 * y0 + z2);
+        const double r01 = std::sqrt(x0 * x0 + y1 * y1 + z2), r11 = std::sqrt(x1 * x1 + y1 * y1 + z2);
+        // e^{i g} ~ (c, s):  g0 ~ (x1 y0, |z| r10), g1 ~ (-x1 y1, |z| r11), g2 ~ (x0 y1, |z| r01), g3 ~ (-x0 y0, |z| r00)
+        auto angle_sum = [](double c0, double s0, double c1, double s1) {
+            double a = std::atan2(c0 * s1 + s0 * c1, c0 * c1 - s0 * s1);
+            return a < 0.0 ? a + 2 * M_PI : a;   // cada ângulo está em (0, pi), a soma em (0, 2 pi)
+        };
+        const double g01 = angle_sum(x1 * y0, az * r10, -x1 * y1, az * r11);
+        const double g23 = angle_sum(x0 * y1, az * r01, -x0 * y0, az * r00);
+        b0 = -y0 / std::sqrt(z2 + y0 * y0);
+        b1 = y1 / std::sqrt(z2 + y1 * y1);
+        k = 2 * M_PI - g23;
+        solid_angle = g01 - k;
+    }
+
+    bool usable() const { return solid_angle >= kMinSolidAngle && solid_angle <= kMaxSolidAngle; }
+
+    // Point (xu, yv) of the rect, in the frame's coordinates, for (u, v) in [0,1)^2
+    void sample(double u, double v, double& xu, double& yv) const {
+        const double au = u * solid_angle + k;
+        const double fu = (std::cos(au) * b0 - b1) / std::sin(au);
+        double cu = std::copysign(1.0, fu) / std::sqrt(fu * fu + b0 * b0);
+        cu = std::clamp(cu, -1.0, 1.0);
+        xu = std::clamp(-(cu * z0) / std::sqrt(std::max(1.0 - cu * cu, 1e-300)), x0, x1);
+        const double d = std::sqrt(xu * xu + z0 * z0);
+        const double h0 = y0 / std::sqrt(d * d + y0 * y0);
+        const double h1 = y1 / std::sqrt(d * d + y1 * y1);
+        const double hv = h0 + v * (h1 - h0);
+        const double hv2 = hv * hv;
+        yv = hv2 < 1.0 - 1e-12 ? std::clamp(hv * d / std::sqrt(1.0 - hv2), y0, y1) : y1;
+    }
+};
+
+// An emissive primitive as seen by next-event estimation. Rects are axis aligned:
+// the plane is coordinate `axis` = k and the extent [a0,a1] x [b0,b1] is over the
+// other two axes in x, y, z order. Emitters are two-sided, like DiffuseLight::emitted().
+struct AreaLight {
+    enum class Shape { Rect, Sphere };
+
+    Shape shape = Shape::Rect;
+    int axis = 1;
+    Real k = 0, a0 = 0, a1 = 0, b0 = 0, b1 = 0;
+    Vec3 center;
+    Real radius = 0;
+    MaterialId mat_id = 0;
+    Vec3 emission;
+    double area = 0;
+
+    static AreaLight rect(int axis, Real a0, Real a1, Real b0, Real b1, Real k, MaterialId mat, const Vec3& emission) {
+        AreaLight l;
+        l.shape = Shape::Rect;
+        l.axis = axis;
+        l.a0 = a0; l.a1 = a1; l.b0 = b0; l.b1 = b1; l.k = k;
+        l.mat_id = mat;
+        l.emission = emission;
+        l.area = static_cast<double>(a1 - a0) * (b1 - b0);
+        return l;
+    }
+
+    static AreaLight sphere(const Vec3& center, Real radius, MaterialId mat, const Vec3& emission) {
+        AreaLight l;
+        l.shape = Shape::Sphere;
+        l.center = center;
+        l.radius = radius;
+        l.mat_id = mat;
+        l.emission = emission;
+        l.area = 4.0 * M_PI * static_cast<double>(radius) * radius;
+        return l;
+    }
+
+    // Emitted power up to a constant (pi, two sides): what the alias table is weighted by.
+    double power() const {
+        return (0.2126 * emission.x + 0.7152 * emission.y + 0.0722 * emission.z) * area;
+    }
+
+    Vec3 rect_point(Real a, Real b) const {
+        if (axis == 0) return Vec3(k, a, b);
+        if (axis == 1) return Vec3(a, k, b);
+        return Vec3(a, b, k);
+    }
+
+    Vec3 rect_normal() const {
+        return Vec3(axis == 0 ? 1 : 0, axis == 1 ? 1 : 0, axis == 2 ? 1 : 0);
+    }
+
+    // Tolerances grow with the coordinates: a float hit point is only good to a few ulps.
+    bool contains(const Vec3& p) const {
+        const Real ulps = 64 * std::numeric_limits<Real>::epsilon();
+        if (shape == Shape::Sphere)
+            return std::fabs((p - center).length() - radius) <= 1e-4 * radius + ulps * (center.length() + radius);
+        Real n = axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+        Real a = axis == 0 ? p.y : p.x;
+        Real b = axis == 2 ? p.y : p.z;
+        Real eps = 1e-6 + ulps * std::max(std::fabs(a), std::fabs(b));
+        return std::fabs(n - k) <= 1e-4 + ulps * std::fabs(k) && a >= a0 - eps && a <= a1 + eps && b >= b0 - eps && b <= b1 + eps;
+    }
+
+    // The rect seen from `from`, in the frame of its own axes
+    SphericalRect spherical_rect(const Vec3& from) const {
+        Real fa = axis == 0 ? from.y : from.x;
+        Real fb = axis == 2 ? from.y : from.z;
+        Real fn = axis == 0 ? from.x : axis == 1 ? from.y : from.z;
+        return SphericalRect(a0 - fa, a1 - fa, b0 - fb, b1 - fb, k - fn);
+    }
+
+    // Samples a point visible from `from`. Returns false if there is none. `pdf` is
+    // with respect to solid angle at `from`; `distance` is the distance to the point.
+    bool sample(const Vec3& from, Sampler& sampler, Vec3& dir, Real& distance, double& pdf,
+                RectLightSampling mode = RectLightSampling::Area) const {
+        double u = sampler.next_1d();
+        double v = sampler.next_1d();
+        if (shape == Shape::Rect && mode == RectLightSampling::SolidAngle) {
+            SphericalRect srect = spherical_rect(from);
+            if (srect.usable()) {
+                double xu, yv;
+                srect.sample(u, v, xu, yv);
+                Real fa = axis == 0 ? from.y : from.x;
+                Real fb = axis == 2 ? from.y : from.z;
+                Vec3 to_light = rect_point(static_cast<Real>(fa + xu), static_cast<Real>(fb + yv)) - from;
+                distance = to_light.length();
+                if (!(distance > 0)) return false;
+                dir = to_light / distance;
+                pdf = 1.0 / srect.solid_angle;
+                return true;
+            }
+        }
+        if (shape == Shape::Rect) {
+            Vec3 to_light = rect_point(a0 + u * (a1 - a0), b0 + v * (b1 - b0)) - from;
+            double distance_squared = to_light.length_squared();
+            distance = std::sqrt(distance_squared);
+            dir = to_light / distance;
+            double cos_light = std::fabs(dot(dir, rect_normal()));
+            if (cos_light <= 0.0) return false;
+            pdf = distance_squared / (cos_light * area);
+            return true;
+        }
+
+        // Esfera: amostra uniforme no cone que ela subtende (de dentro não há cone)
+        Vec3 to_center = center - from;
+        double dc2 = to_center.length_squared();
+        if (dc2 <= radius * radius) return false;
+        double cos_max = std::sqrt(1.0 - radius * radius / dc2);
+        double cos_theta = 1.0 - u * (1.0 - cos_max);
+        double sin_theta = std::sqrt(std::max(0.0, 1.0 - cos_theta * cos_theta));
+        double phi = 2.0 * M_PI * v;
+        Vec3 su, sv, sw;
+        onb_from_w(to_center / std::sqrt(dc2), su, sv, sw);
+        dir = std::cos(phi) * sin_theta * su + std::sin(phi) * sin_theta * sv + cos_theta * sw;
+        // Nearest intersection with the sphere along dir (clamped for grazing directions)
+        double b = dot(dir, to_center);
+        distance = b - std::sqrt(std::max(0.0, b * b - (dc2 - radius * radius)));
+        pdf = 1.0 / (2.0 * M_PI * (1.0 - cos_max));
+        return true;
+    }
+
+    // Solid-angle pdf with which sample() would have produced `point` seen from `from`.
+    double pdf(const Vec3& from, const Vec3& point, RectLightSampling mode = RectLightSampling::Area) const {
+        if (shape == Shape::Rect && mode == RectLightSampling::SolidAngle) {
+            SphericalRect srect = spherical_rect(from);
+            if (srect.usable()) return 1.0 / srect.solid_angle;
+        }
+        Vec3 to_light = point - from;
+        double distance_squared = to_light.length_squared();
+        if (shape == Shape::Rect) {
+            double cos_light = std::fabs(dot(to_light, rect_normal())) / std::sqrt(distance_squared);
+            if (cos_light <= 0.0) return 0.0;
+            return distance_squared / (cos_light * area);
+        }
+        double dc2 = (center - from).length_squared();
+        if (dc2 <= radius * radius) return 0.0;
+        double cos_max = std::sqrt(1.0 - radius * radius / dc2);
+        return 1.0 / (2.0 * M_PI * (1.0 - cos_max));
+    }
+};
+
+// Every emitter of the scene, collected once when the scene is built, plus the
+// power-weighted alias table used to pick one per shading point. The cost of a
+// light sample does not depend on how many lights there are.
+class LightList {
+public:
+    std::vector<AreaLight> lights;
+    AliasTable table;
+    std::vector<std::vector<uint32_t>> by_material;  // mat_id -> lights with that material
+    RectLightSampling rect_sampling = RectLightSampling::Area;
+
+    bool empty() const { return lights.empty(); }
+    size_t size() const { return lights.size(); }
+
+    void add(const AreaLight& light) { lights.push_back(light); }
+
+    void build() {
+        std::vector<double> weights;
+        by_material.clear();
+        for (size_t i = 0; i < lights.size(); ++i) {
+            weights.push_back(lights[i].power());
+            if (lights[i].mat_id >= by_material.size()) by_material.resize(lights[i].mat_id + 1);
+            by_material[lights[i].mat_id].push_back(static_cast<uint32_t>(i));
+        }
+        table.build(weights);
+    }
+
+    // Which light a ray hit. Lights are narrowed down by material, and the (cheap)
+    // containment test always runs, even for a single candidate: an emitter the
+    // list does not hold (see collect_lights) may share the material of one it does.
+    int find(const HitRecord& rec) const {
+        if (rec.mat_id >= by_material.size()) return -1;
+        for (uint32_t i : by_material[rec.mat_id])
+            if (lights[i].contains(rec.p)) return static_cast<int>(i);
+        return -1;
+    }
+
+    // Solid-angle pdf of next-event estimation from `from` toward the emitter point
+    // in `rec` (light selection included); 0 if that point cannot be sampled.
+    double pdf(const Vec3& from, const HitRecord& rec) const {
+        int i = find(rec);
+        if (i < 0) return 0.0;
+        return table.pmf[i] * lights[i].pdf(from, rec.p, rect_sampling);
+    }
+};
+
+inline void collect_lights(const RectArraySoA& rects, int axis, const MaterialTable& materials, LightList& out) {
+    for (size_t i = 0; i < rects.count; ++i) {
+        if (!materials[rects.mats[i]].is_emissive()) continue;
+        out.add(AreaLight::rect(axis, rects.a0[i], rects.a1[i], rects.b0[i], rects.b1[i], rects.k[i],
+                                rects.mats[i], materials[rects.mats[i]].emitted()));
+    }
+}
+
+// Emissive primitives the light list understands: axis-aligned rects (also inside
+// FlatRectSet and Box), spheres and nested lists. Anything else, including emissive
+// Instance and RotatedBox objects, is traced normally but only found by BSDF
+// sampling: no light sample aims at it and its hits get no MIS weight.
+inline void collect_lights(const Hittable& object, const MaterialTable& materials, LightList& out) {
+    auto emissive = [&](MaterialId m) { return materials[m].is_emissive(); };
+    if (auto list = dynamic_cast<const HittableList*>(&object)) {
+        for (const auto& child : list->objects) collect_lights(*child, materials, out);
+    } else if (auto r = dynamic_cast<const XYRect*>(&object)) {
+        if (emissive(r->mat_id)) out.add(AreaLight::rect(2, r->x0, r->x1, r->y0, r->y1, r->k, r->mat_id, materials[r->mat_id].emitted()));
+    } else if (auto r = dynamic_cast<const XZRect*>(&object)) {
+        if (emissive(r->mat_id)) out.add(AreaLight::rect(1, r->x0, r->x1, r->z0, r->z1, r->k, r->mat_id, materials[r->mat_id].emitted()));
+    } else if (auto r = dynamic_cast<const DoubleSidedXZRect*>(&object)) {
+        if (emissive(r->mat_id)) out.add(AreaLight::rect(1, r->x0, r->x1, r->z0, r->z1, r->k, r->mat_id, materials[r->mat_id].emitted()));
+    } else if (auto r = dynamic_cast<const YZRect*>(&object)) {
+        if (emissive(r->mat_id)) out.add(AreaLight::rect(0, r->y0, r->y1, r->z0, r->z1, r->k, r->mat_id, materials[r->mat_id].emitted()));
+    } else if (auto s = dynamic_cast<const Sphere*>(&object)) {
+        if (emissive(s->mat_id)) out.add(AreaLight::sphere(s->center, s->radius, s->mat_id, materials[s->mat_id].emitted()));
+    } else if (auto f = dynamic_cast<const FlatRectSet*>(&object)) {
+        collect_lights(f->xy, 2, materials, out);
+        collect_lights(f->xz, 1, materials, out);
+        collect_lights(f->yz, 0, materials, out);
+    } else if (auto b = dynamic_cast<const Box*>(&object)) {
+        if (emissive(b->mat_id)) collect_lights(b->faces(), materials, out);
+    }
+}
+
+inline LightList build_light_list(const HittableList& objects, const MaterialTable& materials) {
+    LightList lights;
+    collect_lights(objects, materials, lights);
+    lights.build();
+    return lights;
+}
@@ -1,85 +1,380 @@
 #include <cstdlib>
-#include <ctime>
 #include "path_tracer.h"
+#include "progressive.h"
+#include "adaptive.h"
 #include "sphere.h"
 #include "rectangle.h"
 #include "box.h"
 #include "rotated_box.h"
 #include "material.h"
-#include <atomic>
+#include "bvh.h"
+#include "static_scene.h"
+#include "flat_rects.h"
+#include "scene_file.h"
+#include "scene_cache.h"
+#include "cornell.h"
+#include "batch.h"
+#include "denoise.h"
+#include "guiding.h"
+#include "adrrs.h"
+#include "time_budget.h"
+#include <cstdio>
 #include <cstring>
+#include <algorithm>
 #include <iostream>
-
-// runtime flag defined here so path_tracer.cpp can link
-std::atomic<bool> g_use_mis{true};
+#include <chrono>
+#include <string>
+#include <vector>
 
 int main(int argc, char** argv) {
-    srand(time(nullptr));
-
-    // Default parameters
-    int samples_per_pixel = 400;
-    int min_depth = 4;
-    int image_width = 600;
-    int image_height = 600;
-    g_use_mis = true;
+    // Default parameters (ver RenderSettings)
+    RenderSettings settings;
+    std::vector<std::string> outputs;
+    ProgressiveSettings progressive;
+    bool use_progressive = false;
+    AdaptiveSettings adaptive;
+    bool use_adaptive = false;
+    bool use_bvh = true;
+    bool use_flat = true;
+    bool use_virtual_scene = false;
+    RectLightSampling light_sampling = RectLightSampling::Area;
+    std::string scene_path;
+    std::string scene_cache_path;
+    std::string stats_path = "render_stats.json";
+    std::string stats_heatmap_path;
+    std::string jobs_path;
+    std::string jobs_report_path = "batch_report.json";
+    std::string aov_prefix;
+    std::string reference_path;
+    bool use_denoise = false;
+    DenoiseSettings denoise_settings;
+    bool use_guiding = false;
+    int guiding_train = -1;   // -1 = um quarto das amostras
+    bool use_adrrs = false;
+    int adrrs_prepass = -1;   // -1 = um oitavo das amostras, até 16
+    double time_budget = 0.0;   // segundos; 0 = renderiza --samples
 
     // --- Argument parsing (very simples) ---
     for (int i = 1; i < argc; ++i) {
-        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
-            samples_per_pixel = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--min_depth") == 0 && i + 1 < argc) {
-            min_depth = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
-            image_width = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
-            image_height = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--mis_off") == 0) {
-            g_use_mis = false;
+        if (parse_render_flag(argc, argv, i, settings, outputs)) {
+            continue;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            settings.num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no_bvh") == 0) {
+            use_bvh = false;
+        } else if (strcmp(argv[i], "--no_flat") == 0) {
+            use_flat = false;
+        } else if (strcmp(argv[i], "--virtual_scene") == 0) {
+            use_virtual_scene = true;   // BVH de ponteiros e materiais via vtable, p/ comparação
+        } else if (strcmp(argv[i], "--light_sampling") == 0 && i + 1 < argc) {
+            if (!parse_rect_light_sampling(argv[++i], light_sampling))
+                std::cerr << "--light_sampling takes area or solid_angle, using " << rect_light_sampling_name(light_sampling) << '\n';
+        } else if (strcmp(argv[i], "--simd") == 0 && i + 1 < argc) {
+            active_simd_level() = parse_simd_level(argv[++i]);
+        } else if (strcmp(argv[i], "--progressive") == 0 && i + 1 < argc) {
+            use_progressive = true;
+            progressive.pass_samples = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            use_progressive = true;
+            progressive.checkpoint_path = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint_every") == 0 && i + 1 < argc) {
+            progressive.checkpoint_interval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            use_progressive = true;
+            progressive.resume_path = argv[++i];
+        } else if (strcmp(argv[i], "--snapshots") == 0 && i + 1 < argc) {
+            // lista separada por vírgulas, ex.: 50,200
+            use_progressive = true;
+            for (char* tok = strtok(argv[++i], ","); tok; tok = strtok(nullptr, ","))
+                progressive.snapshots.push_back(atoi(tok));
+        } else if (strcmp(argv[i], "--adaptive") == 0 && i + 1 < argc) {
+            use_adaptive = true;
+            adaptive.threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--adaptive_min") == 0 && i + 1 < argc) {
+            adaptive.min_samples = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--adaptive_max") == 0 && i + 1 < argc) {
+            adaptive.max_pixel_samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sample_map") == 0 && i + 1 < argc) {
+            adaptive.sample_map_path = argv[++i];
+        } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            scene_path = argv[++i];
+        } else if (strcmp(argv[i], "--scene_cache") == 0 && i + 1 < argc) {
+            scene_cache_path = argv[++i];   // compilado a partir de --scene se faltar ou estiver velho
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_path = argv[++i];        // só com -DPT_ENABLE_STATS=ON
+        } else if (strcmp(argv[i], "--stats_heatmap") == 0 && i + 1 < argc) {
+            stats_heatmap_path = argv[++i];
+        } else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc) {
+            reference_path = argv[++i];
+        } else if (strcmp(argv[i], "--aov") == 0 && i + 1 < argc) {
+            aov_prefix = argv[++i];
+        } else if (strcmp(argv[i], "--denoise") == 0) {
+            use_denoise = true;
+        } else if (strcmp(argv[i], "--denoise_iterations") == 0 && i + 1 < argc) {
+            use_denoise = true;
+            denoise_settings.iterations = std::clamp(atoi(argv[++i]), 1, 10);
+        } else if (strcmp(argv[i], "--guiding") == 0) {
+            use_guiding = true;
+        } else if (strcmp(argv[i], "--guiding_train") == 0 && i + 1 < argc) {
+            use_guiding = true;
+            guiding_train = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--rr") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "adrrs") == 0) use_adrrs = true;
+            else if (strcmp(argv[i], "classic") == 0) use_adrrs = false;
+            else std::cerr << "--rr takes classic or adrrs, keeping " << (use_adrrs ? "adrrs" : "classic") << '\n';
+        } else if (strcmp(argv[i], "--rr_prepass") == 0 && i + 1 < argc) {
+            use_adrrs = true;
+            adrrs_prepass = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--time_budget") == 0 && i + 1 < argc) {
+            time_budget = atof(argv[++i]);   // passadas até o prazo; --samples é ignorado
+            if (time_budget <= 0.0) std::cerr << "--time_budget takes a positive number of seconds; rendering --samples\n";
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs_path = argv[++i];          // uma renderização por linha, cena montada uma vez
+        } else if (strcmp(argv[i], "--jobs_report") == 0 && i + 1 < argc) {
+            jobs_report_path = argv[++i];
         }
     }
 
+    std::vector<RenderJob> jobs;
+    if (!jobs_path.empty() && !load_job_file(jobs_path, settings, jobs)) return 1;
+    if (outputs.empty()) outputs.push_back("output.ppm");
+
     // Com base na resolução desejada, mantém aspect ratio
     // (assumimos cena quadrada quando não especificado)
 
-    const int max_depth = 10;
+#ifndef PT_STATS
+    if (!stats_heatmap_path.empty())
+        std::cerr << "--stats_heatmap needs a build with -DPT_ENABLE_STATS=ON\n";
+#endif
 
     // World
-    HittableList world;
-
-    // Materials with adjusted light intensity
-    auto red = std::make_shared<Lambertian>(Vec3(0.65, 0.05, 0.05));
-    auto white = std::make_shared<Lambertian>(Vec3(0.73, 0.73, 0.73));
-    auto green = std::make_shared<Lambertian>(Vec3(0.12, 0.45, 0.15));
-    auto light = std::make_shared<DiffuseLight>(Vec3(18, 18, 18));
-
-    // Cornell box walls
-    world.add(std::make_shared<YZRect>(0, 555, 0, 555, 555, green));  // Left wall
-    world.add(std::make_shared<YZRect>(0, 555, 0, 555, 0, red));      // Right wall
-    world.add(std::make_shared<XZRect>(0, 555, 0, 555, 0, white));    // Floor
-    world.add(std::make_shared<XYRect>(0, 555, 0, 555, 555, white));  // Back wall
-    
-    // Ceiling with precise hole for light
-    world.add(std::make_shared<XZRect>(0, 210, 0, 555, 555, white));     // Left part
-    world.add(std::make_shared<XZRect>(346, 555, 0, 555, 555, white));   // Right part  
-    world.add(std::make_shared<XZRect>(210, 346, 0, 224, 555, white));   // Front part
-    world.add(std::make_shared<XZRect>(210, 346, 335, 555, 555, white)); // Back part
-    
-    // Light retângulo (emite apenas para baixo)
-    world.add(std::make_shared<XZRect>(213, 343, 227, 332, 554, light));
-
-    // Rotated boxes for better shadow display
-    world.add(std::make_shared<RotatedBox>(Vec3(130, 0, 65), Vec3(295, 165, 230), white, 15));   // Short box rotated 15°
-    world.add(std::make_shared<RotatedBox>(Vec3(265, 0, 295), Vec3(430, 330, 460), white, -18)); // Tall box rotated -18°
+    [[maybe_unused]] auto build_start = std::chrono::steady_clock::now();
+    Scene scene;
+    CameraDesc camera_desc;
+    bool cached = false;
+    if (!scene_cache_path.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        cached = load_scene_cache(scene_cache_path, scene_path, scene, camera_desc);
+        if (cached) {
+            std::cerr << "Mapped scene cache " << scene_cache_path << " in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+        } else if (scene_path.empty()) {
+            std::cerr << "No usable scene cache " << scene_cache_path << " and no --scene to compile it from\n";
+            return 1;
+        }
+    }
+
+    if (!cached && !scene_path.empty()) {
+        SceneDescription desc;
+        if (!load_scene_file(scene_path, desc)) return 1;
+        std::cerr << "Scene " << scene_path << ": " << desc.primitives.size() << " primitives, "
+                  << desc.materials.size() << " materials\n";
+        if (!scene_cache_path.empty()) {
+            // Compila o cache e renderiza a partir dele, como nas próximas execuções
+            if (!write_scene_cache(scene_cache_path, scene_path, desc) ||
+                !load_scene_cache(scene_cache_path, scene_path, scene, camera_desc)) {
+                std::cerr << "Could not write scene cache " << scene_cache_path << '\n';
+                return 1;
+            }
+            std::cerr << "Wrote scene cache " << scene_cache_path << '\n';
+            cached = true;
+        } else {
+            build_scene(desc, scene);
+            camera_desc = desc.camera;
+        }
+    } else if (!cached) {
+        build_cornell_box(scene);
+    }
+
+    // O cache já traz luzes e BVH prontas
+    bool traced_bvh = cached;
+    if (!cached) {
+        HittableList& world = scene.objects;
+
+        // Lista de luzes para a amostragem direta, montada a partir das primitivas emissivas
+        scene.lights = build_light_list(world, scene.materials);
+
+        // Retângulos alinhados aos eixos vão para o conjunto SoA com kernel SIMD
+        if (use_flat) {
+            world = flatten_rects(world);
+            std::cerr << "Flat rects: kernel " << simd_level_name(active_simd_level()) << '\n';
+        }
+
+        // Aceleração: BVH construída uma única vez sobre a cena pronta
+        // Por padrão com despacho estático (static_scene.h); a BVH é a mesma
+        if (use_bvh && use_virtual_scene) {
+            auto bvh = std::make_shared<BVH>(world);
+            bvh->print_build_stats(std::cerr);
+            scene.accel = bvh;
+        } else if (use_bvh) {
+            auto static_scene = std::make_shared<StaticScene>(world);
+            static_scene->print_build_stats(std::cerr);
+            scene.accel = static_scene;
+        }
+        traced_bvh = use_bvh;
+    }
+    if (use_virtual_scene) {
+        scene.materials.static_dispatch = false;
+        std::cerr << "Virtual dispatch for geometry and materials\n";
+    }
+    scene.lights.rect_sampling = light_sampling;
+    std::cerr << "Lights: " << scene.lights.size() << " emitters, rects sampled by "
+              << rect_light_sampling_name(light_sampling) << '\n';
+
+    if (!jobs.empty()) {
+        if (use_progressive || use_adaptive) std::cerr << "--jobs renders every job in one pass; progressive/adaptive options ignored\n";
+        if (use_denoise || !aov_prefix.empty()) std::cerr << "--jobs does not write AOVs; --aov/--denoise ignored\n";
+        if (use_guiding) std::cerr << "--jobs does not train a guiding tree; --guiding ignored\n";
+        if (use_adrrs) std::cerr << "--jobs uses the classic roulette; --rr adrrs ignored\n";
+        if (time_budget > 0.0) std::cerr << "--jobs renders --samples per job; --time_budget ignored\n";
+        return run_batch(scene, camera_desc, jobs, settings.num_threads, jobs_report_path) ? 0 : 1;
+    }
 
     // Camera
-    Vec3 lookfrom(278, 278, -800);
-    Vec3 lookat(278, 278, 0);
-    Vec3 vup(0, 1, 0);
-    
-    Camera cam(lookfrom, lookat, vup, 40.0, (double)image_width / image_height);
+    Camera cam = camera_desc.make((double)settings.image_width / settings.image_height);
+
+    PT_STAT(render_stats::add_phase("scene_build", std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count()));
+
+    // O adaptativo traça pixel a pixel pelo caminho recursivo, sem pacotes nem wavefront
+    if (use_adaptive && (settings.integrator == IntegratorKind::Wavefront || settings.packet_size > 0)) {
+        std::cerr << "--adaptive traces one recursive ray at a time; --integrator wavefront/--packets ignored\n";
+        settings.integrator = IntegratorKind::Recursive;
+        settings.packet_size = 0;
+    }
+    // AOVs só no laço de render padrão (recursivo, com ou sem pacotes)
+    if ((use_denoise || !aov_prefix.empty()) && (use_adaptive || use_progressive || settings.integrator == IntegratorKind::Wavefront)) {
+        std::cerr << "--aov/--denoise need the plain recursive render; ignored\n";
+        use_denoise = false;
+        aov_prefix.clear();
+    }
+    AovBuffers aovs;
+    // Guiding também: o SD-tree é lido em shade_hit(), que o wavefront não usa
+    if (use_guiding && (use_adaptive || use_progressive || settings.integrator == IntegratorKind::Wavefront)) {
+        std::cerr << "--guiding needs the plain recursive render; ignored\n";
+        use_guiding = false;
+    }
+    // ADRRS idem (o cache é lido em shade_hit()), e não se combina com o guiding
+    if (use_adrrs && (use_guiding || use_adaptive || use_progressive || settings.integrator == IntegratorKind::Wavefront)) {
+        std::cerr << "--rr adrrs needs the plain recursive render without --guiding; ignored\n";
+        use_adrrs = false;
+    }
+    // O orçamento de tempo escolhe as spp sozinho: não se combina com os modos que têm seu próprio plano
+    if (time_budget > 0.0 && (use_adaptive || use_progressive || use_guiding || use_adrrs)) {
+        std::cerr << "--time_budget does not combine with --adaptive, --progressive, --guiding or --rr adrrs; ignored\n";
+        time_budget = 0.0;
+    }
+    if (time_budget > 0.0 && settings.sampler == SamplerKind::Stratified)
+        std::cerr << "--time_budget: the stratified grid is laid out for --samples " << settings.samples_per_pixel
+                  << "; a budget that ends short of it leaves strata empty, and samples past it are independent\n";
 
     // Render
-    render(world, cam, image_width, image_height, samples_per_pixel, max_depth, min_depth);
+    Framebuffer framebuffer;
+    int samples_done = settings.samples_per_pixel;
+    double render_seconds = 0.0;
+    double scale = 1.0 / std::max(samples_done, 1);
+    if (time_budget > 0.0) {
+        TimeBudgetResult budget_result = render_time_budget(scene, cam, settings, time_budget, framebuffer,
+                                                            use_denoise || !aov_prefix.empty() ? &aovs : nullptr);
+        render_seconds = budget_result.seconds;
+        samples_done = budget_result.samples;
+        scale = 1.0 / samples_done;
+    } else if (use_adaptive) {
+        // Buffer sai já normalizado por pixel (cada um tem sua própria contagem)
+        std::vector<float> counts;
+        AdaptiveResult adaptive_result = render_adaptive(scene, cam, settings, adaptive, framebuffer, counts);
+        render_seconds = adaptive_result.seconds;
+        scale = 1.0;
+        if (!adaptive.sample_map_path.empty()) {
+            if (write_heatmap(counts, settings.image_width, settings.image_height, adaptive.sample_map_path))
+                std::cerr << "Wrote " << adaptive.sample_map_path << '\n';
+            else
+                std::cerr << "Could not write " << adaptive.sample_map_path << '\n';
+        }
+    } else if (use_progressive) {
+        // Passadas acumulando no mesmo buffer; snapshots usam os mesmos nomes de saída com sufixo _<N>spp
+        // Só com --scene_cache, o próprio cache identifica a cena do checkpoint
+        progressive.scene_hash = scene_file_hash(!scene_path.empty() ? scene_path : scene_cache_path);
+        auto start = std::chrono::steady_clock::now();
+        samples_done = render_progressive(scene, cam, settings, progressive, framebuffer,
+            [&](const Framebuffer& fb, int spp) {
+                for (const std::string& path : outputs) {
+                    std::string snap = snapshot_path(path, spp);
+                    if (write_image(fb, snap, 1.0 / spp)) std::cerr << "Wrote " << snap << '\n';
+                    else std::cerr << "Could not write " << snap << '\n';
+                }
+            });
+        if (samples_done < 0) return 1;
+        render_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        scale = 1.0 / std::max(samples_done, 1);
+    } else if (use_guiding) {
+        int train = guiding_train >= 0 ? guiding_train : settings.samples_per_pixel / 4;
+        render_seconds = render_guided(scene, cam, settings, train, framebuffer,
+                                       use_denoise || !aov_prefix.empty() ? &aovs : nullptr);
+    } else if (use_adrrs) {
+        int prepass = adrrs_prepass > 0 ? adrrs_prepass : std::clamp(settings.samples_per_pixel / 8, 1, 16);
+        render_seconds = render_adrrs(scene, cam, settings, prepass, framebuffer,
+                                      use_denoise || !aov_prefix.empty() ? &aovs : nullptr);
+    } else {
+        render_seconds = render(scene, cam, settings, framebuffer, use_denoise || !aov_prefix.empty() ? &aovs : nullptr);
+    }
+    PT_STAT(render_stats::add_phase("render", render_seconds));
+    if (traced_bvh) {
+        BVH::print_traversal_stats(std::cerr);
+        std::cerr << "Throughput: " << BVH::traversal_stats().rays / render_seconds / 1e6 << " Mrays/s\n";
+    }
+
+    if (!aov_prefix.empty()) {
+        if (write_aovs(aovs, aov_prefix)) std::cerr << "Wrote " << aov_prefix << "_{albedo,normal,depth,variance}.pfm\n";
+        else std::cerr << "Could not write the AOVs " << aov_prefix << "_*.pfm\n";
+    }
+    if (use_denoise) {
+        // Pós-processo: as saídas recebem a imagem filtrada, já normalizada
+        [[maybe_unused]] auto denoise_start = std::chrono::steady_clock::now();
+        framebuffer = denoise(framebuffer, scale, aovs, denoise_settings, settings.num_threads);
+        scale = 1.0;
+        PT_STAT(render_stats::add_phase("denoise", std::chrono::duration<double>(std::chrono::steady_clock::now() - denoise_start).count()));
+    }
+
+    // Erro contra uma imagem de referência (p.ex. muitas spp): curvas de convergência
+    if (!reference_path.empty()) {
+        Framebuffer reference;
+        if (!read_pfm(reference_path, reference)) {
+            std::cerr << "Could not read reference " << reference_path << '\n';
+        } else {
+            double rmse = image_rmse(framebuffer, scale, reference);
+            if (rmse < 0.0) std::cerr << "Reference " << reference_path << " has a different size\n";
+            else std::cerr << "RMSE vs " << reference_path << ": " << rmse << " (" << sampler_kind_name(settings.sampler)
+                           << ", " << samples_done << " spp)\n";
+        }
+    }
+
+    // Output: a partir do buffer linear, em bloco; o P6 leva as spp num comentário
+    [[maybe_unused]] auto output_start = std::chrono::steady_clock::now();
+    std::string comment;
+    if (!use_adaptive) comment = std::to_string(samples_done) + " spp";
+    if (time_budget > 0.0) {
+        char budget[64];
+        snprintf(budget, sizeof(budget), ", time budget %g s", time_budget);
+        comment += budget;
+    }
+    for (const std::string& path : outputs) {
+        if (!write_image(framebuffer, path, scale, comment)) {
+            std::cerr << "Could not write " << path << '\n';
+            return 1;
+        }
+        std::cerr << "Wrote " << path << '\n';
+    }
+    PT_STAT(render_stats::add_phase("output", std::chrono::duration<double>(std::chrono::steady_clock::now() - output_start).count()));
+
+#ifdef PT_STATS
+    if (render_stats::write_json(stats_path)) std::cerr << "Wrote " << stats_path << '\n';
+    else std::cerr << "Could not write " << stats_path << '\n';
+    if (!stats_heatmap_path.empty()) {
+        if (render_stats::write_tile_heatmap(stats_heatmap_path)) std::cerr << "Wrote " << stats_heatmap_path << '\n';
+        else std::cerr << "Could not write " << stats_heatmap_path << '\n';
+    }
+#endif
 
     return 0;
 } 
\ No newline at end of file
@@ -2,7 +2,12 @@
 #include "ray.h"
 #include "hittable.h"
 #include "vec3.h"
+#include "sampler.h"
+#include <cstdint>
 #include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 struct ScatterRecord {
     Ray scattered;
@@ -13,37 +18,65 @@ struct ScatterRecord {
 class Material {
 public:
     virtual ~Material() {}
-    virtual bool scatter(const Ray& r_in, const HitRecord& rec, Vec3& attenuation, Ray& scattered) const {
+    virtual bool scatter(const Ray& r_in, const HitRecord& rec, Vec3& attenuation, Ray& scattered, Sampler& sampler) const {
         return false;
     }
     virtual Vec3 emitted() const { return Vec3(0, 0, 0); }
     virtual bool is_emissive() const { return false; }
+    // BSDF * cos(theta) toward the unit direction `wi`, used by next-event estimation
+    virtual Vec3 eval(const HitRecord& rec, const Vec3& wi) const { return Vec3(0, 0, 0); }
+    // Solid-angle pdf with which scatter() picks `wi`
+    virtual double scatter_pdf(const HitRecord& rec, const Vec3& wi) const { return 0.0; }
+    // The direction scatter() would pick from the random numbers (u1, u2), for the
+    // path guiding mixture; false if the material has no BSDF sampling
+    virtual bool sample_direction(const HitRecord& rec, double u1, double u2, Vec3& wi) const { return false; }
+    // Surface colour for the albedo AOV and the denoiser's demodulation
+    virtual Vec3 aov_albedo() const { return Vec3(0, 0, 0); }
 };
 
-class Lambertian : public Material {
+class Lambertian final : public Material {
 public:
     Vec3 albedo;
     Lambertian(const Vec3& a) : albedo(a) {}
 
-    virtual bool scatter(const Ray& r_in, const HitRecord& rec, Vec3& attenuation, Ray& scattered) const override {
+    virtual bool scatter(const Ray& r_in, const HitRecord& rec, Vec3& attenuation, Ray& scattered, Sampler& sampler) const override {
+        double r1 = sampler.next_1d();
+        double r2 = sampler.next_1d();
+        Vec3 scatter_direction;
+        sample_direction(rec, r1, r2, scatter_direction);
+        scattered = rec.spawn_ray(scatter_direction);
+        attenuation = albedo;
+        return true;
+    }
+
+    virtual Vec3 eval(const HitRecord& rec, const Vec3& wi) const override {
+        double cos_theta = dot(rec.normal, wi);
+        return cos_theta > 0.0 ? albedo * (cos_theta / M_PI) : Vec3(0, 0, 0);
+    }
+
+    virtual double scatter_pdf(const HitRecord& rec, const Vec3& wi) const override {
+        double cos_theta = dot(rec.normal, wi);
+        return cos_theta > 0.0 ? cos_theta / M_PI : 0.0;
+    }
+
+    virtual bool sample_direction(const HitRecord& rec, double u1, double u2, Vec3& wi) const override {
         // Use cosine-weighted hemisphere sampling
         Vec3 u, v, w;
         onb_from_w(rec.normal, u, v, w);
-        
-        Vec3 direction = random_cosine_direction();
-        Vec3 scatter_direction = direction.x * u + direction.y * v + direction.z * w;
-        
+
+        Vec3 direction = cosine_direction(u1, u2);
+        wi = direction.x * u + direction.y * v + direction.z * w;
+
         // Catch degenerate scatter direction
-        if (scatter_direction.length_squared() < 1e-8)
-            scatter_direction = rec.normal;
-            
-        scattered = Ray(rec.p, scatter_direction);
-        attenuation = albedo;
+        if (wi.length_squared() < 1e-8)
+            wi = rec.normal;
         return true;
     }
+
+    virtual Vec3 aov_albedo() const override { return albedo; }
 };
 
-class DiffuseLight : public Material {
+class DiffuseLight final : public Material {
 public:
     Vec3 emit_color;
     DiffuseLight(const Vec3& c) : emit_color(c) {}
@@ -51,7 +84,50 @@ public:
     virtual Vec3 emitted() const override { return emit_color; }
     virtual bool is_emissive() const override { return true; }
     // Light materials don't scatter - they only emit
-    virtual bool scatter(const Ray& r_in, const HitRecord& rec, Vec3& attenuation, Ray& scattered) const override {
+    virtual bool scatter(const Ray& r_in, const HitRecord& rec, Vec3& attenuation, Ray& scattered, Sampler& sampler) const override {
         return false;
     }
+    // Branco: a emissão passa inalterada pela demodulação do denoiser
+    virtual Vec3 aov_albedo() const override { return Vec3(1, 1, 1); }
+};
+
+// Scene-owned storage for every material. Primitives and hit records refer to a
+// material by its MaterialId (index into this table) instead of holding a shared_ptr.
+class MaterialTable {
+public:
+    // Closed set of material types that visit() hands out with their concrete type
+    enum class Kind : uint8_t { Lambertian, DiffuseLight, Other };
+
+    bool static_dispatch = true;   // false (--virtual_scene): visit() always passes a Material&
+
+    template <typename M, typename... Args>
+    MaterialId add(Args&&... args) {
+        materials.push_back(std::make_unique<M>(std::forward<Args>(args)...));
+        kinds.push_back(std::is_same<M, Lambertian>::value     ? Kind::Lambertian
+                        : std::is_same<M, DiffuseLight>::value ? Kind::DiffuseLight
+                                                               : Kind::Other);
+        return static_cast<MaterialId>(materials.size() - 1);
+    }
+
+    const Material& operator[](MaterialId id) const { return *materials[id]; }
+    size_t size() const { return materials.size(); }
+
+    // Calls f with material `id` as its concrete (final) type, so the calls f makes on
+    // it are direct and inline; other types go through the Material interface.
+    template <typename F>
+    decltype(auto) visit(MaterialId id, F&& f) const {
+        const Material& m = *materials[id];
+        if (static_dispatch) {
+            switch (kinds[id]) {
+                case Kind::Lambertian: return f(static_cast<const Lambertian&>(m));
+                case Kind::DiffuseLight: return f(static_cast<const DiffuseLight&>(m));
+                default: break;
+            }
+        }
+        return f(m);
+    }
+
+private:
+    std::vector<std::unique_ptr<Material>> materials;
+    std::vector<Kind> kinds;
 }; 
\ No newline at end of file
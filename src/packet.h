@@ -0,0 +1,148 @@
+#pragma once
+#include "ray.h"
+#include "aabb.h"
+#include "simd.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+// Primary ray packets (--packets 4|8): the camera rays of one 4x4 or 8x8 pixel block
+// for one sample index. They share the pinhole camera's origin and have nearly the
+// same direction, so a BVH node is first tested once for the whole packet (interval
+// "frustum" test) and only then ray by ray, several rays per SIMD register.
+
+constexpr int kMaxPacketRays = 64;
+
+// One 256-bit vector of Real: 4 doubles or 8 floats. GCC/Clang vector extension, so
+// the same source builds the AVX2 kernels and (split in two) the SSE2 ones.
+constexpr int kPacketLanes = 32 / static_cast<int>(sizeof(Real));
+typedef Real PacketLanes __attribute__((vector_size(32)));
+#define PT_LANES_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define PT_LANES_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+inline uint64_t lane_bits(int first) {
+    constexpr uint64_t block = (uint64_t(1) << kPacketLanes) - 1;
+    return block << first;
+}
+
+struct RayPacket {
+    alignas(32) Real dx[kMaxPacketRays], dy[kMaxPacketRays], dz[kMaxPacketRays];
+    alignas(32) Real inv_dx[kMaxPacketRays], inv_dy[kMaxPacketRays], inv_dz[kMaxPacketRays];
+    Vec3 origin;
+    int count = 0;   // rays in use; the arrays are valid up to padded()
+    uint64_t all = 0;
+
+    // Range of the inverse directions per axis. Only meaningful when `coherent`:
+    // every ray has the same, non-zero sign on each axis.
+    bool coherent = false;
+    Real inv_lo[3], inv_hi[3];
+
+    void reset(const Vec3& o) {
+        origin = o;
+        count = 0;
+    }
+
+    void add(const Vec3& d) {
+        dx[count] = d.x; dy[count] = d.y; dz[count] = d.z;
+        ++count;
+    }
+
+    int padded() const { return (count + kPacketLanes - 1) / kPacketLanes * kPacketLanes; }
+
+    Ray ray(int i) const { return Ray(origin, Vec3(dx[i], dy[i], dz[i])); }
+
+    // Pads the last SIMD block with copies of the last ray (masked out everywhere)
+    // and precomputes reciprocals and the direction intervals.
+    void finalize() {
+        all = count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+        for (int i = count; i < padded(); ++i) {
+            dx[i] = dx[count - 1]; dy[i] = dy[count - 1]; dz[i] = dz[count - 1];
+        }
+        const Real* d[3] = {dx, dy, dz};
+        Real* inv[3] = {inv_dx, inv_dy, inv_dz};
+        coherent = true;
+        for (int a = 0; a < 3; ++a) {
+            bool positive = d[a][0] > 0;
+            inv_lo[a] = std::numeric_limits<Real>::infinity();
+            inv_hi[a] = -std::numeric_limits<Real>::infinity();
+            for (int i = 0; i < padded(); ++i) {
+                inv[a][i] = 1 / d[a][i];
+                if (d[a][i] == 0 || (d[a][i] > 0) != positive) coherent = false;
+                inv_lo[a] = std::min(inv_lo[a], inv[a][i]);
+                inv_hi[a] = std::max(inv_hi[a], inv[a][i]);
+            }
+        }
+    }
+
+    // Conservative frustum test: false only if no ray of the packet can enter `box`
+    // before `t_max`. Interval arithmetic over the inverse directions; every ray's
+    // slab distances lie inside these bounds.
+    bool may_hit(const AABB& box, Real t_max) const {
+        if (!coherent) return true;
+        const Real o[3] = {origin.x, origin.y, origin.z};
+        const Real lo[3] = {box.minimum.x, box.minimum.y, box.minimum.z};
+        const Real hi[3] = {box.maximum.x, box.maximum.y, box.maximum.z};
+        Real t_near = 0, t_far = t_max;
+        for (int a = 0; a < 3; ++a) {
+            // Near slab is the min side for positive directions, the max side otherwise
+            bool positive = inv_lo[a] > 0;
+            Real near_d = (positive ? lo[a] : hi[a]) - o[a];
+            Real far_d = (positive ? hi[a] : lo[a]) - o[a];
+            t_near = std::max(t_near, std::min(near_d * inv_lo[a], near_d * inv_hi[a]));
+            t_far = std::min(t_far, std::max(far_d * inv_lo[a], far_d * inv_hi[a]));
+        }
+        return t_near <= t_far;
+    }
+};
+
+// Slab test of every ray in `active` against `box`, the same arithmetic as
+// AABB::hit() in SIMD lanes. Returns the rays that enter the box before their own
+// t_max[i]; `t_entry` gets the nearest entry distance among them.
+__attribute__((always_inline))
+inline uint64_t packet_box_mask_lanes(const RayPacket& p, const AABB& box, uint64_t active,
+                                      const Real* t_max, Real& t_entry) {
+    const PacketLanes zero = PacketLanes{} + Real(0);
+    const PacketLanes ox = zero + p.origin.x, oy = zero + p.origin.y, oz = zero + p.origin.z;
+    const PacketLanes x0 = zero + box.minimum.x, y0 = zero + box.minimum.y, z0 = zero + box.minimum.z;
+    const PacketLanes x1 = zero + box.maximum.x, y1 = zero + box.maximum.y, z1 = zero + box.maximum.z;
+    uint64_t result = 0;
+    t_entry = std::numeric_limits<Real>::infinity();
+
+    for (int i = 0; i < p.padded(); i += kPacketLanes) {
+        if ((active & lane_bits(i)) == 0) continue;
+        const PacketLanes ix = *reinterpret_cast<const PacketLanes*>(&p.inv_dx[i]);
+        const PacketLanes iy = *reinterpret_cast<const PacketLanes*>(&p.inv_dy[i]);
+        const PacketLanes iz = *reinterpret_cast<const PacketLanes*>(&p.inv_dz[i]);
+        const PacketLanes tmax = *reinterpret_cast<const PacketLanes*>(&t_max[i]);
+        PacketLanes tx0 = (x0 - ox) * ix, tx1 = (x1 - ox) * ix;
+        PacketLanes ty0 = (y0 - oy) * iy, ty1 = (y1 - oy) * iy;
+        PacketLanes tz0 = (z0 - oz) * iz, tz1 = (z1 - oz) * iz;
+        PacketLanes near = PT_LANES_MAX(PT_LANES_MAX(PT_LANES_MIN(tx0, tx1), PT_LANES_MIN(ty0, ty1)),
+                                        PT_LANES_MAX(PT_LANES_MIN(tz0, tz1), zero));
+        PacketLanes far = PT_LANES_MIN(PT_LANES_MIN(PT_LANES_MAX(tx0, tx1), PT_LANES_MAX(ty0, ty1)),
+                                       PT_LANES_MIN(PT_LANES_MAX(tz0, tz1), tmax));
+        auto inside = near <= far;
+        for (int l = 0; l < kPacketLanes; ++l) {
+            if (inside[l] && ((active >> (i + l)) & 1)) {
+                result |= uint64_t(1) << (i + l);
+                t_entry = std::min(t_entry, near[l]);
+            }
+        }
+    }
+    return result;
+}
+
+#ifdef PT_HAVE_X86_SIMD
+__attribute__((target("avx2")))
+inline uint64_t packet_box_mask_avx2(const RayPacket& p, const AABB& box, uint64_t active, const Real* t_max, Real& t_entry) {
+    return packet_box_mask_lanes(p, box, active, t_max, t_entry);
+}
+#endif
+
+// Below AVX2 the vectors are lowered to the baseline instruction set (SSE2 on x86-64).
+inline uint64_t packet_box_mask(const RayPacket& p, const AABB& box, uint64_t active, const Real* t_max, Real& t_entry) {
+#ifdef PT_HAVE_X86_SIMD
+    if (active_simd_level() == SimdLevel::AVX2) return packet_box_mask_avx2(p, box, active, t_max, t_entry);
+#endif
+    return packet_box_mask_lanes(p, box, active, t_max, t_entry);
+}
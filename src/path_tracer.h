@@ -1,161 +1,389 @@
 #pragma once
-#include "hittable_list.h"
+#include "scene.h"
 #include "camera.h"
-#include "material.h"
-#include <fstream>
+#include "tile_scheduler.h"
+#include "sampler.h"
+#include "light_sampling.h"
+#include "render_settings.h"
+#include "wavefront.h"
+#include "image.h"
+#include "render_stats.h"
+#include "aov.h"
+#include "sd_tree.h"
+#include "adjoint_cache.h"
+#include <chrono>
 #include <limits>
 #include <algorithm>
 #include <cmath>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
-// Global runtime flag set by main.cpp to (de)ativar Multiple-Importance Sampling.
-extern std::atomic<bool> g_use_mis;
+Vec3 ray_color(const Ray& r, const Scene& scene, const RenderSettings& settings, int depth, int min_depth, Sampler& sampler,
+               double pdf_brdf = 0.0, HitRecord* first_hit = nullptr, double path_weight = 1.0);
 
-// Sample a point on the rectangular light and return its contribution together with the pdf of the chosen sampling strategy.
-struct LightSample {
-    Vec3 Li;       // Incoming radiance from the light (already includes geometry term)
-    double pdf;    // Pdf value w.r.t. solid angle at the hit point
-};
-
-inline LightSample sample_light_direct(const Vec3& hit_point, const Vec3& normal, const Hittable& world) {
-    // Light rectangle parameters (matches main.cpp)
-    double x0 = 213, x1 = 343, z0 = 227, z1 = 332, y = 554;
-    
-    // Random point on light
-    double u = (double)rand() / RAND_MAX;
-    double v = (double)rand() / RAND_MAX;
-    Vec3 light_point(x0 + u * (x1 - x0), y, z0 + v * (z1 - z0));
-    
-    // Direction to light (and related geometric terms)
-    Vec3 to_light = light_point - hit_point;
-    double distance_squared = to_light.length_squared();
-    Vec3 light_dir  = unit_vector(to_light);
+// shade_hit() with the material as its static type M (MaterialTable::visit), so
+// emission, scattering and pdf calls are direct for the built-in materials.
+template <typename M>
+Vec3 shade_material(const M& mat, const Ray& r, const HitRecord& rec, const Scene& scene, const RenderSettings& settings,
+                    int depth, int min_depth, Sampler& sampler, double pdf_brdf, double path_weight) {
+    Vec3 emitted = mat.emitted();
     
-    // Check if light is visible (shadow ray)
-    Ray shadow_ray(hit_point, light_dir);
-    HitRecord shadow_rec;
-    if (world.hit(shadow_ray, 0.001, std::sqrt(distance_squared) - 0.001, shadow_rec)) {
-        if (!shadow_rec.mat_ptr->is_emissive()) {
-            return {Vec3(0, 0, 0), 1.0};  // Light is blocked
-        }
+    // If we hit a light source directly, return its emission (MIS-weighted after a BSDF bounce)
+    if (mat.is_emissive()) {
+        PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
+        if (!settings.use_mis || pdf_brdf <= 0.0)
+            return emitted;
+        double w_brdf = power_heuristic(pdf_brdf, scene.lights.pdf(r.origin(), rec));
+        PT_STAT(render_stats::Counters::add_weight(render_stats::local().brdf_weight, w_brdf));
+        return emitted * w_brdf;
     }
     
-    // Geometry term
-    double cos_theta_surface = dot(normal, light_dir);
-    if (cos_theta_surface <= 0.0) return {Vec3(0,0,0), 1.0};
-
-    // Light area and emission (must match main.cpp)
-    double light_area = (x1 - x0) * (z1 - z0);
-    Vec3 light_emission(18, 18, 18);
+    // Path guiding (--guiding): materials with a BSDF pdf sample the mixture of the
+    // BSDF and the SD-tree leaf around rec.p, with the same two sampler dimensions
+    // mat.scatter() would use. The mixture pdf then stands in for the BSDF pdf below.
+    SDTree::Leaf* guide = settings.guide && mat.scatter_pdf(rec, rec.normal) > 0.0 ? &settings.guide->leaf(rec.p) : nullptr;
+    const double guide_fraction = guide && guide->can_sample() ? SDTree::kGuideFraction : 0.0;
+    auto mixture_pdf = [&](const Vec3& wi, double guide_pdf) {
+        return guide_fraction * guide_pdf + (1.0 - guide_fraction) * mat.scatter_pdf(rec, wi);
+    };
+    auto scatter_pdf = [&](const Vec3& wi) {
+        return guide_fraction > 0.0 ? mixture_pdf(wi, guide->pdf(wi)) : mat.scatter_pdf(rec, wi);
+    };
 
-    // Normal of the light (faces down along -Y)
-    Vec3 light_normal(0, -1, 0);
-    double cos_theta_light = std::fabs(dot(light_dir * -1.0, light_normal));
-    if (cos_theta_light <= 0.0) return {Vec3(0,0,0), 1.0};
-
-    // pdf converting from area measure to solid angle measure
-    double pdf_light = distance_squared / (cos_theta_light * light_area);
-
-    Vec3 Li = light_emission * cos_theta_surface / pdf_light;
-    return {Li, pdf_light};
-}
-
-// Power heuristic for MIS
-inline double power_heuristic(double pdf_a, double pdf_b) {
-    double a = pdf_a * pdf_a;
-    double b = pdf_b * pdf_b;
-    return a / (a + b);
-}
-
-Vec3 ray_color(const Ray& r, const Hittable& world, int depth, int min_depth) {
-    if (depth <= 0)
-        return Vec3(0, 0, 0);
-
-    HitRecord rec;
-    if (!world.hit(r, 0.001, std::numeric_limits<double>::infinity(), rec)) {
-        // background color
-        return Vec3(0, 0, 0);
-    }
-
-    Vec3 emitted = rec.mat_ptr->emitted();
-    
-    // If we hit a light source directly, return its emission
-    if (rec.mat_ptr->is_emissive()) {
-        return emitted;
-    }
-    
     // For diffuse materials, try to scatter
+    auto sample_scatter = [&](Ray& scattered, Vec3& attenuation, double& guided_pdf) {
+        if (!guide) return mat.scatter(r, rec, attenuation, scattered, sampler);
+        double u = sampler.next_1d();
+        double v = sampler.next_1d();
+        Vec3 wi;
+        if (u < guide_fraction) {
+            double guide_pdf;
+            wi = unit_vector(guide->sample(u / guide_fraction, v, guide_pdf));
+            guided_pdf = mixture_pdf(wi, guide_pdf);
+        } else {
+            mat.sample_direction(rec, (u - guide_fraction) / (1.0 - guide_fraction), v, wi);
+            wi = unit_vector(wi);
+            guided_pdf = scatter_pdf(wi);
+        }
+        attenuation = guided_pdf > 0.0 ? mat.eval(rec, wi) / guided_pdf : Vec3(0, 0, 0);
+        scattered = rec.spawn_ray(wi);
+        return true;
+    };
+    // Indirect radiance brought back along `scattered`, times `attenuation`
+    auto continue_path = [&](const Ray& scattered, const Vec3& attenuation, double guided_pdf, double weight) {
+        // pdf da amostragem via BRDF, usada se o próximo vértice for uma luz
+        Vec3 wi = unit_vector(scattered.direction());
+        double next_pdf = guide ? guided_pdf : mat.scatter_pdf(rec, wi);
+        if (guide && attenuation.x == 0 && attenuation.y == 0 && attenuation.z == 0) {
+            // Direção guiada abaixo da superfície: nada a seguir
+            PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
+            return Vec3(0, 0, 0);
+        }
+        Vec3 L_indirect = ray_color(scattered, scene, settings, depth - 1, min_depth - 1, sampler, next_pdf, nullptr,
+                                    weight * guiding_detail::luminance(attenuation));
+        if (guide && settings.guide->recording && next_pdf > 0.0)
+            guide->record(wi, guiding_detail::luminance(L_indirect) / next_pdf);
+        return attenuation * L_indirect;
+    };
+
     Ray scattered;
     Vec3 attenuation;
-    if (rec.mat_ptr->scatter(r, rec, attenuation, scattered)) {
+    double guided_pdf = 0.0;
+    if (sample_scatter(scattered, attenuation, guided_pdf)) {
+        // Adjoint-driven roulette and splitting (--rr adrrs) decide the continuation
+        // after the light sample, where the cache has an estimate; elsewhere the
+        // classic roulette below still applies
+        AdjointCache* adjoint = settings.adjoint;
+        double share = adjoint && !adjoint->recording ? adjoint->contribution(rec, sampler, path_weight) : -1.0;
+
         // RUSSIAN ROULETTE – só começamos depois de cumprir a profundidade mínima
-        if (min_depth <= 0) {
-            double max_component = std::max(attenuation.x, std::max(attenuation.y, attenuation.z));
+        double rr_scale = 1.0;
+        if (min_depth <= 0 && share < 0.0) {
+            // Guiado, eval/pdf oscila com a direção: a sobrevivência vem do albedo
+            Vec3 reflectance = guide ? mat.aov_albedo() : attenuation;
+            double max_component = std::max(reflectance.x, std::max(reflectance.y, reflectance.z));
             double survival_prob = std::min(max_component, 0.95);  // Cap at 95%
             
-            if ((double)rand() / RAND_MAX > survival_prob)
+            if (sampler.next_1d() > survival_prob) {
+                PT_STAT(++render_stats::local().rr_terminations);
+                PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
+                if (adjoint && adjoint->recording) adjoint->record(rec, 0.0f);
                 return emitted; // Terminate
+            }
             attenuation = attenuation / survival_prob; // compensate
+            rr_scale = 1.0 / survival_prob;
         }
         
-        // === Amostragem de luz direta ===
-        LightSample lightSample = sample_light_direct(rec.p, rec.normal, world);
-
-        // pdf da amostragem via BRDF (cosine-weighted)
-        double cos_theta = dot(rec.normal, scattered.direction());
-        double pdf_brdf = cos_theta > 0.0 ? cos_theta / M_PI : 0.0;
-
-        // Heurísticas de potência (MIS)
-        double w_light;
-        double w_brdf;
-        if (g_use_mis) {
-            w_light = power_heuristic(lightSample.pdf, pdf_brdf);
-            w_brdf  = power_heuristic(pdf_brdf, lightSample.pdf);
-        } else {
-            w_light = 0.0;      // sem MIS: consideramos só caminho via BRDF
-            w_brdf  = 1.0;
+        // === Amostragem de luz direta (sem MIS: só o caminho via BRDF) ===
+        Vec3 L_direct(0, 0, 0);
+        if (settings.use_mis) {
+            LightSample lightSample = sample_light_direct(rec.p, rec.normal, scene, sampler);
+            if (lightSample.pdf > 0.0) {
+                double w_light = power_heuristic(lightSample.pdf, scatter_pdf(lightSample.dir));
+                PT_STAT(render_stats::Counters::add_weight(render_stats::local().light_weight, w_light));
+                L_direct = mat.eval(rec, lightSample.dir) * lightSample.Li * (w_light * rr_scale);
+                if (guide && settings.guide->recording)
+                    guide->record(lightSample.dir, guiding_detail::luminance(lightSample.Li) * w_light);
+            }
         }
 
-        Vec3 L_direct  = attenuation * w_light * lightSample.Li;
+        int splits = 1;
+        if (share >= 0.0) {
+            double survival;
+            AdjointCache::window(share, survival, splits);
+            if (survival < 1.0) {
+                if (sampler.next_1d() > survival) {
+                    PT_STAT(++render_stats::local().rr_terminations);
+                    PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
+                    return emitted + L_direct;
+                }
+                attenuation = attenuation / survival;
+            }
+        }
 
-        Vec3 L_indirect = ray_color(scattered, world, depth - 1, min_depth - 1);
-        L_indirect = attenuation * w_brdf * L_indirect;
+        Vec3 L_indirect;
+        if (splits == 1) {
+            L_indirect = continue_path(scattered, attenuation, guided_pdf, path_weight);
+        } else {
+            // Cada ramo amostra sua própria direção, com seus próprios números (Sampler::split)
+            PT_STAT(render_stats::local().splits += splits - 1);
+            const Sampler at_vertex = sampler;
+            L_indirect = continue_path(scattered, attenuation, guided_pdf, path_weight / splits);
+            for (int b = 1; b < splits; ++b) {
+                sampler = at_vertex;
+                sampler.split(b);
+                if (sample_scatter(scattered, attenuation, guided_pdf))
+                    L_indirect += continue_path(scattered, attenuation, guided_pdf, path_weight / splits);
+            }
+            L_indirect = L_indirect / splits;
+        }
+        if (adjoint && adjoint->recording) adjoint->record(rec, guiding_detail::luminance(L_indirect));
 
         return emitted + L_direct + L_indirect;
     }
     
     // If material doesn't scatter (like pure emissive), just return emission
+    PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
     return emitted;
 }
 
-void render(const Hittable& world, const Camera& cam, int image_width, int image_height, int samples_per_pixel, int max_depth, int min_depth) {
-    std::ofstream out("output.ppm");
-    out << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-    for (int j = image_height - 1; j >= 0; --j) {
-        std::cerr << "Scanlines remaining: " << j << '\r';
-        for (int i = 0; i < image_width; ++i) {
+// Radiance leaving the hit `rec` of `r` back along the ray, after the sampler has
+// moved to this vertex. Split from ray_color() so packet-traced camera rays can
+// enter the same path.
+Vec3 shade_hit(const Ray& r, const HitRecord& rec, const Scene& scene, const RenderSettings& settings, int depth,
+               int min_depth, Sampler& sampler, double pdf_brdf, double path_weight = 1.0) {
+    return scene.materials.visit(rec.mat_id, [&](const auto& mat) {
+        return shade_material(mat, r, rec, scene, settings, depth, min_depth, sampler, pdf_brdf, path_weight);
+    });
+}
+
+// `pdf_brdf` is the solid-angle pdf with which the previous vertex's BSDF picked
+// `r` (0 for camera rays). When `r` reaches an emitter, its emission is weighted
+// against the light sample that vertex took; every other radiance is unweighted.
+// `first_hit`, when given, receives the intersection of `r` itself (untouched on a miss).
+// `path_weight` is the luminance of the path's throughput up to `r` (for --rr adrrs).
+Vec3 ray_color(const Ray& r, const Scene& scene, const RenderSettings& settings, int depth, int min_depth, Sampler& sampler,
+               double pdf_brdf, HitRecord* first_hit, double path_weight) {
+    if (depth <= 0) {
+        PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
+        return Vec3(0, 0, 0);
+    }
+
+    // Cada vértice do caminho consome suas próprias dimensões do sampler
+    sampler.next_bounce();
+    PT_STAT(++(sampler.current_bounce() == 1 ? render_stats::local().camera_rays : render_stats::local().extension_rays));
+
+    HitRecord rec;
+    bool hit;
+    {
+        PT_STAT(render_stats::IntersectTimer timer);
+        hit = scene.world().hit(r, 0, std::numeric_limits<Real>::infinity(), rec);
+    }
+    if (!hit) {
+        // background color
+        PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
+        return Vec3(0, 0, 0);
+    }
+    if (first_hit) *first_hit = rec;
+    return shade_hit(r, rec, scene, settings, depth, min_depth, sampler, pdf_brdf, path_weight);
+}
+
+// One camera sample into the AOV buffers: its first hit (nullptr on a miss) and radiance
+inline void add_aov_sample(AovBuffers& aovs, size_t pixel, const Scene& scene, const Ray& r, const HitRecord* first,
+                           const Vec3& color) {
+    if (!first) {
+        aovs.add_sample(pixel, false, Vec3(0, 0, 0), Vec3(0, 0, 0), 0.0, color);
+        return;
+    }
+    aovs.add_sample(pixel, true, scene.material(*first).aov_albedo(), first->normal, first->t * r.direction().length(),
+                    color);
+}
+
+// Packet mode (--packets N): the tile is walked in N x N pixel blocks and, for each
+// sample index, the block's camera rays are intersected as one RayPacket. From the
+// first hit on every path continues alone through shade_hit()/ray_color(), with the
+// sampler dimensions and summation order of the per-pixel loop: same image.
+void render_tile_packets(const Scene& scene, const Camera& cam, const RenderSettings& settings, const Tile& tile,
+                         Framebuffer& framebuffer, int first_sample, int num_samples, AovBuffers* aovs) {
+    const int size = settings.packet_size;
+    const int image_width = settings.image_width;
+    const int image_height = settings.image_height;
+    std::vector<Sampler> samplers(kMaxPacketRays, Sampler(settings.seed, settings.sampler, settings.samples_per_pixel));
+    auto packet = std::make_unique<RayPacket>();
+    auto hits = std::make_unique<PacketHits>();
+
+    for (int by = tile.y0; by < tile.y1; by += size) {
+        for (int bx = tile.x0; bx < tile.x1; bx += size) {
+            const int y1 = std::min(by + size, tile.y1);
+            const int x1 = std::min(bx + size, tile.x1);
+            Vec3 pixel_color[kMaxPacketRays];
+            size_t pixel_index[kMaxPacketRays];
+            int k = 0;
+            for (int row = by; row < y1; ++row)
+                for (int i = bx; i < x1; ++i)
+                    pixel_index[k++] = static_cast<size_t>(row) * image_width + i;
+
+            for (int s = first_sample; s < first_sample + num_samples; ++s) {
+                packet->reset(cam.origin);
+                for (int row = by; row < y1; ++row) {
+                    for (int i = bx; i < x1; ++i) {
+                        Sampler& sampler = samplers[packet->count];
+                        sampler.start_sample(i, image_height - 1 - row, s);
+                        packet->add(jittered_camera_ray(cam, i, image_height - 1 - row, image_width, image_height, sampler).direction());
+                    }
+                }
+                packet->finalize();
+                hits->reset();
+                {
+                    PT_STAT(render_stats::IntersectTimer timer);
+                    scene.world().hit_packet(*packet, packet->all, *hits);
+                }
+
+                for (int k = 0; k < packet->count; ++k) {
+                    Sampler& sampler = samplers[k];
+                    sampler.next_bounce();
+                    PT_STAT(++render_stats::local().camera_rays);
+                    const bool hit = (hits->mask >> k) & 1;
+                    Vec3 color(0, 0, 0);
+                    if (hit) {
+                        color = shade_hit(packet->ray(k), hits->rec[k], scene, settings, settings.max_depth,
+                                          settings.min_depth, sampler, 0.0);
+                    } else {
+                        PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
+                    }
+                    pixel_color[k] += color;
+                    if (aovs) add_aov_sample(*aovs, pixel_index[k], scene, packet->ray(k), hit ? &hits->rec[k] : nullptr, color);
+                }
+            }
+
+            for (k = 0; k < packet->count; ++k) framebuffer.add(pixel_index[k], pixel_color[k]);
+        }
+    }
+}
+
+// Samples [first_sample, first_sample + num_samples) of the pixels of one tile, with
+// the integrator the settings select; `wavefront` is the calling worker's
+// integrator when that is the wavefront one. `aovs`, when given, also gets every
+// sample's first hit (not filled by the wavefront integrator).
+void render_tile(const Scene& scene, const Camera& cam, const RenderSettings& settings, const Tile& tile,
+                 Framebuffer& framebuffer, int first_sample, int num_samples, WavefrontIntegrator* wavefront,
+                 AovBuffers* aovs = nullptr) {
+    if (wavefront) {
+        wavefront->render_tile(tile, framebuffer, first_sample, num_samples);
+        return;
+    }
+    if (settings.packet_size > 0 && settings.max_depth > 0) {
+        render_tile_packets(scene, cam, settings, tile, framebuffer, first_sample, num_samples, aovs);
+        return;
+    }
+
+    const int image_width = settings.image_width;
+    const int image_height = settings.image_height;
+    Sampler sampler(settings.seed, settings.sampler, settings.samples_per_pixel);
+    for (int row = tile.y0; row < tile.y1; ++row) {
+        int j = image_height - 1 - row;
+        for (int i = tile.x0; i < tile.x1; ++i) {
+            const size_t pixel = static_cast<size_t>(row) * image_width + i;
             Vec3 pixel_color(0, 0, 0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = (i + ((double) rand() / RAND_MAX)) / (image_width - 1);
-                auto v = (j + ((double) rand() / RAND_MAX)) / (image_height - 1);
-                Ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, world, max_depth, min_depth);
+            for (int s = first_sample; s < first_sample + num_samples; ++s) {
+                sampler.start_sample(i, j, s);
+                Ray r = jittered_camera_ray(cam, i, j, image_width, image_height, sampler);
+                if (!aovs) {
+                    pixel_color += ray_color(r, scene, settings, settings.max_depth, settings.min_depth, sampler);
+                    continue;
+                }
+                HitRecord first;
+                first.t = std::numeric_limits<Real>::infinity();
+                Vec3 color = ray_color(r, scene, settings, settings.max_depth, settings.min_depth, sampler, 0.0, &first);
+                pixel_color += color;
+                add_aov_sample(*aovs, pixel, scene, r, first.t < std::numeric_limits<Real>::infinity() ? &first : nullptr,
+                               color);
             }
-            // Write color
-            auto scale = 1.0 / samples_per_pixel;
-            auto r = pixel_color.x * scale;
-            auto g = pixel_color.y * scale;
-            auto b = pixel_color.z * scale;
-            // Gamma correction sqrt
-            r = std::sqrt(r);
-            g = std::sqrt(g);
-            b = std::sqrt(b);
-
-            int ir = static_cast<int>(256 * std::clamp(r, 0.0, 0.999));
-            int ig = static_cast<int>(256 * std::clamp(g, 0.0, 0.999));
-            int ib = static_cast<int>(256 * std::clamp(b, 0.0, 0.999));
-            out << ir << ' ' << ig << ' ' << ib << '\n';
+            framebuffer.add(pixel, pixel_color);
         }
     }
-    std::cerr << "Done.          \n";
-} 
\ No newline at end of file
+}
+
+// Adds samples [first_sample, first_sample + num_samples) of every pixel to the
+// radiance sums in `framebuffer` and returns the wall-clock time spent tracing.
+// Sample indices key the sampler, so rendering 0..N in one call or in several
+// passes traces exactly the same paths.
+double render_pass(const Scene& scene, const Camera& cam, const RenderSettings& settings, Framebuffer& framebuffer,
+                   int first_sample, int num_samples, AovBuffers* aovs = nullptr) {
+    const int image_width = settings.image_width;
+    const int image_height = settings.image_height;
+
+    // Framebuffer compartilhado: cada tile escreve apenas nos seus próprios pixels, sem locks.
+    std::vector<Tile> tiles = make_tiles(image_width, image_height, settings.tile_size);
+    WorkStealingScheduler scheduler(resolve_thread_count(settings.num_threads));
+    PT_STAT(render_stats::begin_tiles(tiles, image_width, image_height));
+
+    // Integrador wavefront: um conjunto de buffers SoA por worker, reaproveitado entre tiles
+    std::vector<std::unique_ptr<WavefrontIntegrator>> wavefront;
+    if (settings.integrator == IntegratorKind::Wavefront) {
+        for (int w = 0; w < scheduler.num_workers(); ++w)
+            wavefront.push_back(std::make_unique<WavefrontIntegrator>(scene, cam, settings));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::mutex progress_mutex;
+    size_t tiles_done = 0;
+    double samples_done = 0.0;
+    const double pass_samples = static_cast<double>(image_width) * image_height * num_samples;
+
+    scheduler.run(tiles.size(), [&](size_t tile_index, int worker) {
+        const Tile& tile = tiles[tile_index];
+        PT_STAT(auto tile_start = std::chrono::steady_clock::now());
+        render_tile(scene, cam, settings, tile, framebuffer, first_sample, num_samples,
+                    wavefront.empty() ? nullptr : wavefront[worker].get(), aovs);
+
+        PT_STAT(render_stats::record_tile(tile_index,
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - tile_start).count()));
+
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        ++tiles_done;
+        samples_done += static_cast<double>(tile.x1 - tile.x0) * (tile.y1 - tile.y0) * num_samples;
+        // Vazão e ETA desta passada, pelos tiles já prontos
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double eta = samples_done > 0.0 ? elapsed * (pass_samples / samples_done - 1.0) : 0.0;
+        std::cerr << "Tiles remaining: " << tiles.size() - tiles_done << ", " << samples_done / elapsed / 1e6
+                  << " Msamples/s, ETA " << eta << " s    \r";
+    });
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Renders all samples_per_pixel samples into a fresh `framebuffer` and returns the
+// wall-clock time spent tracing. With `aovs`, also fills fresh, finished AOV buffers.
+double render(const Scene& scene, const Camera& cam, const RenderSettings& settings, Framebuffer& framebuffer,
+              AovBuffers* aovs = nullptr) {
+    framebuffer = Framebuffer(settings.image_width, settings.image_height);
+    if (aovs) *aovs = AovBuffers(settings.image_width, settings.image_height);
+    std::cerr << "Rendering on " << resolve_thread_count(settings.num_threads) << " threads\n";
+    double elapsed = render_pass(scene, cam, settings, framebuffer, 0, settings.samples_per_pixel, aovs);
+    if (aovs) aovs->finish(settings.samples_per_pixel);
+    std::cerr << "Done in " << elapsed << " s.          \n";
+    return elapsed;
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include "path_tracer.h"
+#include "image.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct ProgressiveSettings {
+    int pass_samples = 16;               // amostras por pixel em cada passada
+    std::string checkpoint_path;         // vazio = sem checkpoint
+    double checkpoint_interval = 60.0;   // segundos entre checkpoints
+    std::string resume_path;             // vazio = começa do zero
+    std::vector<int> snapshots;          // contagens de spp que geram imagens intermediárias
+    uint64_t scene_hash = 0;             // scene_file_hash() da cena renderizada
+};
+
+// FNV-1a of the file the scene was loaded from, so a checkpoint is not resumed
+// onto another scene. 0 for the built-in Cornell box (empty path).
+inline uint64_t scene_file_hash(const std::string& path) {
+    if (path.empty()) return 0;
+    std::ifstream in(path, std::ios::binary);
+    uint64_t hash = 14695981039346656037ull;
+    char buffer[4096];
+    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+        for (std::streamsize i = 0; i < in.gcount(); ++i) {
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// On-disk checkpoint: the float sum buffer plus everything needed to continue the
+// same sample sequence. The sampler is counter-based, so its whole state is the
+// seed and the number of samples already taken per pixel.
+struct Checkpoint {
+    static constexpr char kMagic[4] = {'P', 'T', 'C', 'K'};
+    static constexpr uint32_t kVersion = 6;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        int32_t width, height;
+        uint64_t seed;
+        int32_t max_depth, min_depth;
+        int32_t samples_done;
+        int32_t use_mis;
+        int32_t sampler;   // SamplerKind: outra sequência não continuaria a estratificação
+        int32_t grid_samples;   // --samples do alvo: o estratificado monta sua grade para esse número
+        int32_t light_sampling;   // RectLightSampling: outra pdf mudaria o estimador da luz direta
+        int32_t pad;
+        uint64_t scene_hash;
+    };
+
+    // Writes to a temporary file first so a crash mid-write keeps the previous checkpoint.
+    static bool save(const std::string& path, const RenderSettings& settings, RectLightSampling light_sampling,
+                     uint64_t scene_hash, const Framebuffer& fb, int samples_done) {
+        Header h{};
+        std::memcpy(h.magic, kMagic, 4);
+        h.version = kVersion;
+        h.width = fb.width;
+        h.height = fb.height;
+        h.seed = settings.seed;
+        h.max_depth = settings.max_depth;
+        h.min_depth = settings.min_depth;
+        h.samples_done = samples_done;
+        h.use_mis = settings.use_mis ? 1 : 0;
+        h.sampler = static_cast<int32_t>(settings.sampler);
+        h.grid_samples = settings.samples_per_pixel;
+        h.light_sampling = static_cast<int32_t>(light_sampling);
+        h.scene_hash = scene_hash;
+
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            if (!out) return false;
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            out.write(reinterpret_cast<const char*>(fb.data.data()), static_cast<std::streamsize>(fb.data.size() * sizeof(float)));
+            if (!out) return false;
+        }
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    // Fails (with a message) if the file is missing, corrupt or was rendered with
+    // settings or a scene that would make the added samples inconsistent.
+    static bool load(const std::string& path, const RenderSettings& settings, RectLightSampling light_sampling,
+                     uint64_t scene_hash, Framebuffer& fb, int& samples_done) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Could not open checkpoint " << path << '\n';
+            return false;
+        }
+        Header h;
+        in.read(reinterpret_cast<char*>(&h), sizeof(h));
+        if (!in || std::memcmp(h.magic, kMagic, 4) != 0 || h.version != kVersion) {
+            std::cerr << "Not a checkpoint file: " << path << '\n';
+            return false;
+        }
+        if (h.width != settings.image_width || h.height != settings.image_height || h.seed != settings.seed ||
+            h.max_depth != settings.max_depth || h.min_depth != settings.min_depth || h.use_mis != (settings.use_mis ? 1 : 0) ||
+            h.sampler != static_cast<int32_t>(settings.sampler) || h.light_sampling != static_cast<int32_t>(light_sampling)) {
+            std::cerr << "Checkpoint " << path << " was rendered with different settings ("
+                      << h.width << "x" << h.height << ", seed " << h.seed << ", min_depth " << h.min_depth
+                      << (h.use_mis ? "" : ", --mis_off") << ", sampler "
+                      << sampler_kind_name(static_cast<SamplerKind>(h.sampler)) << ", light_sampling "
+                      << rect_light_sampling_name(static_cast<RectLightSampling>(h.light_sampling)) << ")\n";
+            return false;
+        }
+        // O estratificado é uma grade de --samples células por pixel: outro alvo misturaria duas grades
+        if (settings.sampler == SamplerKind::Stratified && h.grid_samples != settings.samples_per_pixel) {
+            std::cerr << "Checkpoint " << path << " was rendered with --sampler stratified toward " << h.grid_samples
+                      << " spp; its grid only continues with --samples " << h.grid_samples << '\n';
+            return false;
+        }
+        if (h.scene_hash != scene_hash) {
+            std::cerr << "Checkpoint " << path << " was rendered from a different scene\n";
+            return false;
+        }
+        fb = Framebuffer(h.width, h.height);
+        in.read(reinterpret_cast<char*>(fb.data.data()), static_cast<std::streamsize>(fb.data.size() * sizeof(float)));
+        if (!in) {
+            std::cerr << "Truncated checkpoint " << path << '\n';
+            return false;
+        }
+        samples_done = h.samples_done;
+        return true;
+    }
+};
+
+// "out/image.ppm" + 50 -> "out/image_50spp.ppm"
+inline std::string snapshot_path(const std::string& path, int spp) {
+    size_t slash = path.find_last_of("/\\");
+    size_t dot = path.find_last_of('.');
+    std::string tag = "_" + std::to_string(spp) + "spp";
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path + tag;
+    return path.substr(0, dot) + tag + path.substr(dot);
+}
+
+// Renders in passes of `pass_samples` until settings.samples_per_pixel samples have
+// been accumulated, starting from a checkpoint when one is given. Pass boundaries
+// are placed on every snapshot count so on_snapshot sees exactly that many samples.
+// Returns the number of samples per pixel in `fb`, or -1 if resuming failed.
+inline int render_progressive(const Scene& scene, const Camera& cam, const RenderSettings& settings,
+                              const ProgressiveSettings& progressive, Framebuffer& fb,
+                              const std::function<void(const Framebuffer&, int)>& on_snapshot) {
+    int done = 0;
+    if (!progressive.resume_path.empty()) {
+        if (!Checkpoint::load(progressive.resume_path, settings, scene.lights.rect_sampling, progressive.scene_hash, fb, done)) return -1;
+        std::cerr << "Resumed " << progressive.resume_path << " at " << done << " spp\n";
+    } else {
+        fb = Framebuffer(settings.image_width, settings.image_height);
+    }
+
+    std::vector<int> snapshots = progressive.snapshots;
+    std::sort(snapshots.begin(), snapshots.end());
+
+    const int target = settings.samples_per_pixel;
+    const int pass_samples = std::max(progressive.pass_samples, 1);
+    auto last_checkpoint = std::chrono::steady_clock::now();
+    double total_seconds = 0.0;
+    std::cerr << "Progressive rendering to " << target << " spp on "
+              << resolve_thread_count(settings.num_threads) << " threads\n";
+
+    while (done < target) {
+        int n = std::min(pass_samples, target - done);
+        for (int s : snapshots) {
+            if (s > done) {
+                n = std::min(n, s - done);
+                break;
+            }
+        }
+
+        double seconds = render_pass(scene, cam, settings, fb, done, n);
+        done += n;
+        total_seconds += seconds;
+        std::cerr << "Pass done: " << done << "/" << target << " spp (" << n / seconds << " spp/s)      \n";
+
+        if (std::find(snapshots.begin(), snapshots.end(), done) != snapshots.end())
+            on_snapshot(fb, done);
+
+        bool due = std::chrono::duration<double>(std::chrono::steady_clock::now() - last_checkpoint).count()
+                   >= progressive.checkpoint_interval;
+        if (!progressive.checkpoint_path.empty() && (due || done == target)) {
+            if (Checkpoint::save(progressive.checkpoint_path, settings, scene.lights.rect_sampling, progressive.scene_hash, fb, done))
+                std::cerr << "Checkpoint " << progressive.checkpoint_path << " at " << done << " spp\n";
+            else
+                std::cerr << "Could not write checkpoint " << progressive.checkpoint_path << '\n';
+            last_checkpoint = std::chrono::steady_clock::now();
+        }
+    }
+
+    std::cerr << "Done in " << total_seconds << " s.          \n";
+    return done;
+}
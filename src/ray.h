@@ -1,19 +1,68 @@
 #pragma once
 #include "vec3.h"
+#include <cstdint>
+#include <cstring>
+#include <limits>
 
-class Ray {
+template <typename T>
+class RayT {
 public:
-    Vec3 orig;
-    Vec3 dir;
+    Vec3T<T> orig;
+    Vec3T<T> dir;
 
-    Ray() {}
-    Ray(const Vec3& origin, const Vec3& direction)
+    RayT() {}
+    RayT(const Vec3T<T>& origin, const Vec3T<T>& direction)
         : orig(origin), dir(direction) {}
 
-    Vec3 origin() const { return orig; }
-    Vec3 direction() const { return dir; }
+    Vec3T<T> origin() const { return orig; }
+    Vec3T<T> direction() const { return dir; }
 
-    Vec3 at(double t) const {
+    Vec3T<T> at(T t) const {
         return orig + t * dir;
     }
-}; 
\ No newline at end of file
+};
+
+using Ray = RayT<Real>;
+
+// Constants of offset_ray_origin() per scalar type: an offset of int_scale ulps
+// per unit of normal, and a fixed step near the origin where ulps get tiny.
+template <typename T> struct RayOffsetTraits;
+
+template <> struct RayOffsetTraits<float> {
+    using Bits = int32_t;
+    static constexpr float origin = 1.0f / 32.0f;
+    static constexpr float float_scale = 1.0f / 65536.0f;
+    static constexpr float int_scale = 256.0f;
+};
+
+template <> struct RayOffsetTraits<double> {
+    using Bits = int64_t;
+    static constexpr double origin = 1.0 / 32.0;
+    static constexpr double float_scale = 1.0 / 65536.0 / 536870912.0;  // 2^29 = ulp de float / ulp de double
+    static constexpr double int_scale = 256.0;
+};
+
+// Origin for a ray leaving a surface at p on the side n points to (Wächter & Binder,
+// Ray Tracing Gems, ch. 6). The step is a number of ulps of each coordinate, so it
+// covers the rounding error of the hit point at any scene scale and precision, and
+// the new ray can start at t = 0 instead of a fixed epsilon.
+template <typename T>
+inline Vec3T<T> offset_ray_origin(const Vec3T<T>& p, const Vec3T<T>& n) {
+    using Traits = RayOffsetTraits<T>;
+    using Bits = typename Traits::Bits;
+    auto offset = [](T pi, T ni) {
+        if (std::fabs(pi) < Traits::origin) return pi + Traits::float_scale * ni;
+        Bits bits;
+        std::memcpy(&bits, &pi, sizeof(bits));
+        Bits ulps = static_cast<Bits>(Traits::int_scale * ni);
+        bits += (pi < 0) ? -ulps : ulps;
+        T moved;
+        std::memcpy(&moved, &bits, sizeof(moved));
+        return moved;
+    };
+    return Vec3T<T>(offset(p.x, n.x), offset(p.y, n.y), offset(p.z, n.z));
+}
+
+// Shadow rays stop this fraction short of the sampled light point.
+template <typename T>
+constexpr T shadow_ray_shortening() { return T(512) * std::numeric_limits<T>::epsilon(); }
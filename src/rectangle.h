@@ -1,18 +1,17 @@
 #pragma once
 #include "hittable.h"
-#include "material.h"
 
-class XYRect : public Hittable {
+class XYRect final : public Hittable {
 public:
-    double x0, x1, y0, y1, k;
-    std::shared_ptr<Material> mp;
+    Real x0, x1, y0, y1, k;
+    MaterialId mat_id;
 
     XYRect() {}
-    XYRect(double _x0, double _x1, double _y0, double _y1, double _k,
-           std::shared_ptr<Material> mat)
-        : x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mp(mat) {}
+    XYRect(Real _x0, Real _x1, Real _y0, Real _y1, Real _k,
+           MaterialId mat)
+        : x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mat_id(mat) {}
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override {
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
         auto t = (k - r.origin().z) / r.direction().z;
         if (t < t_min || t > t_max)
             return false;
@@ -21,25 +20,41 @@ public:
         if (x < x0 || x > x1 || y < y0 || y > y1)
             return false;
         rec.t = t;
-        rec.p = r.at(t);
+        // Exactly on the plane, so offset_ray_origin() only has to undo rounding in x, y
+        rec.p = Vec3(x, y, k);
         Vec3 outward_normal = Vec3(0, 0, 1);
         rec.set_face_normal(r, outward_normal);
-        rec.mat_ptr = mp;
+        rec.mat_id = mat_id;
         return true;
     }
+
+    // Shadow rays: the same test as hit(), without the record
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        auto t = (k - r.origin().z) / r.direction().z;
+        if (t < t_min || t > t_max)
+            return false;
+        auto x = r.origin().x + t * r.direction().x;
+        auto y = r.origin().y + t * r.direction().y;
+        return !(x < x0 || x > x1 || y < y0 || y > y1);
+    }
+
+    // Pad the thin dimension so the box has non-zero volume
+    virtual AABB bounding_box() const override {
+        return AABB(Vec3(x0, y0, k - 0.0001), Vec3(x1, y1, k + 0.0001));
+    }
 };
 
-class XZRect : public Hittable {
+class XZRect final : public Hittable {
 public:
-    double x0, x1, z0, z1, k;
-    std::shared_ptr<Material> mp;
+    Real x0, x1, z0, z1, k;
+    MaterialId mat_id;
 
     XZRect() {}
-    XZRect(double _x0, double _x1, double _z0, double _z1, double _k,
-           std::shared_ptr<Material> mat)
-        : x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mp(mat) {}
+    XZRect(Real _x0, Real _x1, Real _z0, Real _z1, Real _k,
+           MaterialId mat)
+        : x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mat_id(mat) {}
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override {
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
         auto t = (k - r.origin().y) / r.direction().y;
         if (t < t_min || t > t_max)
             return false;
@@ -48,25 +63,38 @@ public:
         if (x < x0 || x > x1 || z < z0 || z > z1)
             return false;
         rec.t = t;
-        rec.p = r.at(t);
+        rec.p = Vec3(x, k, z);
         Vec3 outward_normal = Vec3(0, 1, 0);
         rec.set_face_normal(r, outward_normal);
-        rec.mat_ptr = mp;
+        rec.mat_id = mat_id;
         return true;
     }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        auto t = (k - r.origin().y) / r.direction().y;
+        if (t < t_min || t > t_max)
+            return false;
+        auto x = r.origin().x + t * r.direction().x;
+        auto z = r.origin().z + t * r.direction().z;
+        return !(x < x0 || x > x1 || z < z0 || z > z1);
+    }
+
+    virtual AABB bounding_box() const override {
+        return AABB(Vec3(x0, k - 0.0001, z0), Vec3(x1, k + 0.0001, z1));
+    }
 };
 
-class YZRect : public Hittable {
+class YZRect final : public Hittable {
 public:
-    double y0, y1, z0, z1, k;
-    std::shared_ptr<Material> mp;
+    Real y0, y1, z0, z1, k;
+    MaterialId mat_id;
 
     YZRect() {}
-    YZRect(double _y0, double _y1, double _z0, double _z1, double _k,
-           std::shared_ptr<Material> mat)
-        : y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mp(mat) {}
+    YZRect(Real _y0, Real _y1, Real _z0, Real _z1, Real _k,
+           MaterialId mat)
+        : y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mat_id(mat) {}
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override {
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
         auto t = (k - r.origin().x) / r.direction().x;
         if (t < t_min || t > t_max)
             return false;
@@ -75,26 +103,39 @@ public:
         if (y < y0 || y > y1 || z < z0 || z > z1)
             return false;
         rec.t = t;
-        rec.p = r.at(t);
+        rec.p = Vec3(k, y, z);
         Vec3 outward_normal = Vec3(1, 0, 0);
         rec.set_face_normal(r, outward_normal);
-        rec.mat_ptr = mp;
+        rec.mat_id = mat_id;
         return true;
     }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        auto t = (k - r.origin().x) / r.direction().x;
+        if (t < t_min || t > t_max)
+            return false;
+        auto y = r.origin().y + t * r.direction().y;
+        auto z = r.origin().z + t * r.direction().z;
+        return !(y < y0 || y > y1 || z < z0 || z > z1);
+    }
+
+    virtual AABB bounding_box() const override {
+        return AABB(Vec3(k - 0.0001, y0, z0), Vec3(k + 0.0001, y1, z1));
+    }
 };
 
 // Double-sided light rectangle that emits from both sides
-class DoubleSidedXZRect : public Hittable {
+class DoubleSidedXZRect final : public Hittable {
 public:
-    double x0, x1, z0, z1, k;
-    std::shared_ptr<Material> mp;
+    Real x0, x1, z0, z1, k;
+    MaterialId mat_id;
 
     DoubleSidedXZRect() {}
-    DoubleSidedXZRect(double _x0, double _x1, double _z0, double _z1, double _k,
-           std::shared_ptr<Material> mat)
-        : x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mp(mat) {}
+    DoubleSidedXZRect(Real _x0, Real _x1, Real _z0, Real _z1, Real _k,
+           MaterialId mat)
+        : x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mat_id(mat) {}
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override {
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
         auto t = (k - r.origin().y) / r.direction().y;
         if (t < t_min || t > t_max)
             return false;
@@ -103,12 +144,25 @@ public:
         if (x < x0 || x > x1 || z < z0 || z > z1)
             return false;
         rec.t = t;
-        rec.p = r.at(t);
-        // Always face towards the ray (double-sided)
+        rec.p = Vec3(x, k, z);
+        // Always face towards the ray (Real-sided)
         Vec3 outward_normal = Vec3(0, 1, 0);
         if (r.direction().y > 0) outward_normal = Vec3(0, -1, 0);
         rec.set_face_normal(r, outward_normal);
-        rec.mat_ptr = mp;
+        rec.mat_id = mat_id;
         return true;
     }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        auto t = (k - r.origin().y) / r.direction().y;
+        if (t < t_min || t > t_max)
+            return false;
+        auto x = r.origin().x + t * r.direction().x;
+        auto z = r.origin().z + t * r.direction().z;
+        return !(x < x0 || x > x1 || z < z0 || z > z1);
+    }
+
+    virtual AABB bounding_box() const override {
+        return AABB(Vec3(x0, k - 0.0001, z0), Vec3(x1, k + 0.0001, z1));
+    }
 }; 
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "sampler.h"
+
+class SDTree;
+class AdjointCache;
+
+enum class IntegratorKind { Recursive, Wavefront };
+
+struct RenderSettings {
+    int image_width = 600;
+    int image_height = 600;
+    int samples_per_pixel = 400;
+    int max_depth = 10;
+    int min_depth = 4;
+    int num_threads = 0;   // 0 = usa todos os núcleos disponíveis
+    int tile_size = 16;
+    uint64_t seed = 1;
+    IntegratorKind integrator = IntegratorKind::Recursive;
+    bool use_mis = true;   // --mis_off: só o caminho via BRDF, sem amostragem de luz
+    int packet_size = 0;   // lado dos blocos de raios primários (4 ou 8); 0 = um raio por vez
+    SamplerKind sampler = SamplerKind::Independent;
+    SDTree* guide = nullptr;   // posto por render_guided() durante --guiding
+    AdjointCache* adjoint = nullptr;   // posto por render_adrrs() durante --rr adrrs
+};
+
+// Flags that describe one render: shared by the command line and the lines of a
+// batch job file. Consumes argv[i] (and its value) and returns true if it was one.
+inline bool parse_render_flag(int argc, char** argv, int& i, RenderSettings& settings, std::vector<std::string>& outputs) {
+    if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+        settings.samples_per_pixel = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--min_depth") == 0 && i + 1 < argc) {
+        settings.min_depth = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+        settings.image_width = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+        settings.image_height = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+        settings.tile_size = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+        settings.seed = strtoull(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--integrator") == 0 && i + 1 < argc) {
+        ++i;
+        if (strcmp(argv[i], "wavefront") == 0) settings.integrator = IntegratorKind::Wavefront;
+        else if (strcmp(argv[i], "recursive") == 0) settings.integrator = IntegratorKind::Recursive;
+        else std::cerr << "Unknown integrator '" << argv[i] << "', using recursive\n";
+    } else if (strcmp(argv[i], "--packets") == 0 && i + 1 < argc) {
+        // blocos 4x4 ou 8x8 de raios primários traçados juntos (integrador recursivo)
+        int size = atoi(argv[++i]);
+        if (size == 4 || size == 8) settings.packet_size = size;
+        else std::cerr << "--packets takes 4 or 8, tracing one ray at a time\n";
+    } else if (strcmp(argv[i], "--sampler") == 0 && i + 1 < argc) {
+        ++i;
+        if (!parse_sampler_kind(argv[i], settings.sampler))
+            std::cerr << "Unknown sampler '" << argv[i] << "' (independent, stratified, halton, sobol), keeping "
+                      << sampler_kind_name(settings.sampler) << '\n';
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+        outputs.push_back(argv[++i]);   // .pfm = HDR linear, demais = PPM binário (P6)
+    } else if (strcmp(argv[i], "--mis_off") == 0) {
+        settings.use_mis = false;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,185 @@
+#pragma once
+#include "bvh.h"
+#include "image.h"
+#include "tile_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Opt-in render statistics (cmake -DPT_ENABLE_STATS=ON defines PT_STATS). Without
+// it every PT_STAT(...) expands to nothing, so the hot paths carry no counters.
+#ifdef PT_STATS
+#define PT_STAT(...) __VA_ARGS__
+#else
+#define PT_STAT(...)
+#endif
+
+namespace render_stats {
+
+constexpr int kDepthBins = 65;   // comprimento do caminho em vértices (0..64)
+constexpr int kWeightBins = 10;  // histograma dos pesos MIS em [0, 1]
+
+struct Counters {
+    uint64_t camera_rays = 0;
+    uint64_t extension_rays = 0;
+    uint64_t shadow_rays = 0;
+    uint64_t shadow_occluded = 0;
+    uint64_t rr_terminations = 0;
+    uint64_t splits = 0;                      // extra branches from --rr adrrs splitting
+    uint64_t path_length[kDepthBins] = {};
+    uint64_t light_weight[kWeightBins] = {};  // w_light of light samples that reached the light
+    uint64_t brdf_weight[kWeightBins] = {};   // w_brdf of emitters found by BSDF sampling
+    double intersect_seconds = 0.0;           // time inside closest-hit queries
+
+    void end_path(int vertices) { ++path_length[std::min(std::max(vertices, 0), kDepthBins - 1)]; }
+
+    static void add_weight(uint64_t* bins, double w) {
+        ++bins[std::min(kWeightBins - 1, static_cast<int>(std::max(w, 0.0) * kWeightBins))];
+    }
+
+    void merge(const Counters& o) {
+        camera_rays += o.camera_rays;
+        extension_rays += o.extension_rays;
+        shadow_rays += o.shadow_rays;
+        shadow_occluded += o.shadow_occluded;
+        rr_terminations += o.rr_terminations;
+        splits += o.splits;
+        for (int i = 0; i < kDepthBins; ++i) path_length[i] += o.path_length[i];
+        for (int i = 0; i < kWeightBins; ++i) {
+            light_weight[i] += o.light_weight[i];
+            brdf_weight[i] += o.brdf_weight[i];
+        }
+        intersect_seconds += o.intersect_seconds;
+    }
+};
+
+// Same scheme as the BVH counters: each thread counts locally and merges into the
+// totals when it exits (or when the report is written, for the calling thread).
+inline std::mutex totals_mutex;
+inline Counters totals;
+
+struct ThreadCounters {
+    Counters counters;
+    ~ThreadCounters() { flush(); }
+    void flush() {
+        std::lock_guard<std::mutex> lock(totals_mutex);
+        totals.merge(counters);
+        counters = Counters();
+    }
+};
+inline thread_local ThreadCounters thread_counters;
+
+inline Counters& local() { return thread_counters.counters; }
+
+// Times a closest-hit query into the thread's counters.
+struct IntersectTimer {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ~IntersectTimer() {
+        local().intersect_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// Wall-clock phases and per-tile render time (summed over passes).
+struct Timings {
+    std::vector<std::pair<std::string, double>> phases;
+    int width = 0, height = 0;
+    std::vector<Tile> tiles;
+    std::vector<double> tile_seconds;
+};
+inline Timings timings;
+
+inline void add_phase(const std::string& name, double seconds) {
+    for (auto& phase : timings.phases) {
+        if (phase.first == name) {
+            phase.second += seconds;
+            return;
+        }
+    }
+    timings.phases.push_back({name, seconds});
+}
+
+inline void begin_tiles(const std::vector<Tile>& tiles, int width, int height) {
+    if (timings.tiles.size() == tiles.size() && timings.width == width && timings.height == height) return;
+    timings.tiles = tiles;
+    timings.width = width;
+    timings.height = height;
+    timings.tile_seconds.assign(tiles.size(), 0.0);
+}
+
+// Each tile index is rendered by one worker at a time, so no lock is needed.
+inline void record_tile(size_t index, double seconds) { timings.tile_seconds[index] += seconds; }
+
+inline Counters merged() {
+    thread_counters.flush();
+    std::lock_guard<std::mutex> lock(totals_mutex);
+    return totals;
+}
+
+inline bool write_json(const std::string& path) {
+    Counters c = merged();
+    BVHTraversalStats bvh = BVH::traversal_stats();
+    std::ofstream out(path);
+    if (!out) return false;
+
+    double render_seconds = 0.0;
+    for (const auto& phase : timings.phases)
+        if (phase.first == "render") render_seconds = phase.second;
+    double tile_total = 0.0, tile_max = 0.0;
+    for (double t : timings.tile_seconds) {
+        tile_total += t;
+        tile_max = std::max(tile_max, t);
+    }
+    auto list = [&](const uint64_t* values, int n) {
+        out << '[';
+        for (int i = 0; i < n; ++i) out << (i ? ", " : "") << values[i];
+        out << ']';
+    };
+
+    out << std::setprecision(6) << "{\n  \"phases\": {";
+    for (size_t i = 0; i < timings.phases.size(); ++i)
+        out << (i ? ", " : "") << '"' << timings.phases[i].first << "\": " << timings.phases[i].second;
+    out << "},\n";
+    out << "  \"rays\": {\"camera\": " << c.camera_rays << ", \"extension\": " << c.extension_rays
+        << ", \"shadow\": " << c.shadow_rays << ", \"shadow_occluded\": " << c.shadow_occluded
+        << ", \"occlusion_rate\": " << (c.shadow_rays ? static_cast<double>(c.shadow_occluded) / c.shadow_rays : 0.0) << "},\n";
+    out << "  \"bvh\": {\"rays\": " << bvh.rays << ", \"nodes_visited\": " << bvh.nodes_visited
+        << ", \"primitive_tests\": " << bvh.primitive_tests << "},\n";
+    out << "  \"rr_terminations\": " << c.rr_terminations << ",\n";
+    out << "  \"splits\": " << c.splits << ",\n";
+    out << "  \"path_length_histogram\": ";
+    list(c.path_length, kDepthBins);
+    out << ",\n  \"mis_light_weight_histogram\": ";
+    list(c.light_weight, kWeightBins);
+    out << ",\n  \"mis_brdf_weight_histogram\": ";
+    list(c.brdf_weight, kWeightBins);
+    // Summed over threads; compare with tile time to see if the scene is intersection-bound
+    out << ",\n  \"intersect_seconds\": " << c.intersect_seconds
+        << ",\n  \"intersect_fraction\": " << (tile_total > 0.0 ? c.intersect_seconds / tile_total : 0.0);
+    out << ",\n  \"tiles\": {\"count\": " << timings.tiles.size() << ", \"total_seconds\": " << tile_total
+        << ", \"max_seconds\": " << tile_max << ", \"render_seconds\": " << render_seconds << ", \"seconds\": [";
+    for (size_t i = 0; i < timings.tile_seconds.size(); ++i) out << (i ? ", " : "") << timings.tile_seconds[i];
+    out << "]}\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Every pixel gets its tile's time per pixel, in microseconds.
+inline bool write_tile_heatmap(const std::string& path) {
+    std::vector<float> values(static_cast<size_t>(timings.width) * timings.height, 0.0f);
+    for (size_t t = 0; t < timings.tiles.size(); ++t) {
+        const Tile& tile = timings.tiles[t];
+        double pixels = static_cast<double>((tile.x1 - tile.x0) * (tile.y1 - tile.y0));
+        float us = static_cast<float>(timings.tile_seconds[t] * 1e6 / pixels);
+        for (int y = tile.y0; y < tile.y1; ++y)
+            for (int x = tile.x0; x < tile.x1; ++x)
+                values[static_cast<size_t>(y) * timings.width + x] = us;
+    }
+    return write_heatmap(values, timings.width, timings.height, path);
+}
+
+}  // namespace render_stats
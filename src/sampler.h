@@ -0,0 +1,277 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Which sequence next_1d() draws from (--sampler). Every kind is keyed on
+// (seed, pixel, sample index, bounce, dimension) only, so all of them keep the
+// sampler free of shared state and independent of the tile schedule.
+enum class SamplerKind { Independent, Stratified, Halton, Sobol };
+
+inline const char* sampler_kind_name(SamplerKind kind) {
+    switch (kind) {
+        case SamplerKind::Stratified: return "stratified";
+        case SamplerKind::Halton: return "halton";
+        case SamplerKind::Sobol: return "sobol";
+        default: return "independent";
+    }
+}
+
+inline bool parse_sampler_kind(const char* name, SamplerKind& kind) {
+    for (SamplerKind k : {SamplerKind::Independent, SamplerKind::Stratified, SamplerKind::Halton, SamplerKind::Sobol}) {
+        if (strcmp(name, sampler_kind_name(k)) == 0) {
+            kind = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Counter-based random numbers: every value is a pure function of
+// (seed, pixel, sample index, bounce, dimension). There is no hidden state shared
+// between threads, and a pixel sample produces the same numbers no matter which
+// thread renders it or in which order the tiles are scheduled.
+//
+// Each path vertex owns kDimensionsPerBounce dimensions, always used in this order:
+//   bounce 0 (camera):  0-1 pixel jitter
+//   bounce >= 1:        0-1 cosine direction, 2 roulette, 3 light choice, 4-5 point on the light
+// The low-discrepancy kinds cover those dimensions; anything past them (or past the
+// sequence's range) falls back to the independent hash.
+class Sampler {
+public:
+    static constexpr int kDimensionsPerBounce = 8;
+
+    explicit Sampler(uint64_t seed = 0, SamplerKind kind = SamplerKind::Independent, int samples_per_pixel = 1)
+        : seed(mix64(seed + 0x9E3779B97F4A7C15ull)), kind(kind),
+          samples_per_pixel(samples_per_pixel > 0 ? static_cast<uint32_t>(samples_per_pixel) : 1) {
+        // Grade m x n == samples_per_pixel do estratificado: m é o maior divisor <= sqrt,
+        // para não sobrar célula vazia (32 = 4 x 8, não 5 x 7)
+        grid_m = std::max<uint32_t>(1, static_cast<uint32_t>(std::sqrt(static_cast<double>(this->samples_per_pixel))));
+        while (this->samples_per_pixel % grid_m != 0) --grid_m;
+        grid_n = this->samples_per_pixel / grid_m;
+    }
+
+    // Start a new camera sample for pixel (px, py). Resets bounce and dimension.
+    void start_sample(int px, int py, int sample_index) {
+        uint64_t pixel = (static_cast<uint64_t>(static_cast<uint32_t>(py)) << 32) | static_cast<uint32_t>(px);
+        pixel_key = mix64(seed ^ mix64(pixel));
+        sample_key = pixel_key + static_cast<uint64_t>(sample_index) * 0xD1B54A32D192ED03ull;
+        index = static_cast<uint32_t>(sample_index);
+        pixel_xy[0] = px;
+        pixel_xy[1] = py;
+        branched = false;
+        bounce = 0;
+        start_bounce();
+    }
+
+    // Path splitting (--rr adrrs): branch 0 keeps the numbers of the unsplit path,
+    // branch b > 0 rekeys the rest of the path on b. The sequences are per camera
+    // sample, so other branches draw independent numbers.
+    void split(int branch) {
+        if (branch == 0) return;
+        sample_key = mix64(sample_key ^ (static_cast<uint64_t>(bounce) << 32 | static_cast<uint32_t>(branch)));
+        branched = true;
+        start_bounce();
+    }
+
+    // Called once per path vertex: the next dimensions are keyed on a new bounce index.
+    void next_bounce() {
+        ++bounce;
+        start_bounce();
+    }
+
+    // Uniform double in [0, 1).
+    double next_1d() {
+        const uint32_t d = dimension++;
+        if (kind != SamplerKind::Independent && !branched && d < kDimensionsPerBounce) {
+            switch (kind) {
+                case SamplerKind::Stratified:
+                    if (index < samples_per_pixel) return stratified(d);
+                    break;
+                case SamplerKind::Halton: {
+                    const uint32_t g = static_cast<uint32_t>(bounce) * kDimensionsPerBounce + d;
+                    if (g < kHaltonDimensions) return halton(g);
+                    break;
+                }
+                case SamplerKind::Sobol:
+                    return sobol(d);
+                default:
+                    break;
+            }
+        }
+        return uniform(bounce_key + static_cast<uint64_t>(d) * 0x9E3779B97F4A7C15ull);
+    }
+
+    int current_bounce() const { return bounce; }
+    int pixel_x() const { return pixel_xy[0]; }
+    int pixel_y() const { return pixel_xy[1]; }
+
+private:
+    static constexpr uint32_t kHaltonDimensions = 64;
+
+    uint64_t seed;
+    SamplerKind kind;
+    uint32_t samples_per_pixel;
+    uint32_t grid_m = 1, grid_n = 1;
+    uint64_t pixel_key = 0;
+    uint64_t sample_key = 0;
+    uint64_t bounce_key = 0;
+    uint32_t index = 0;
+    int pixel_xy[2] = {0, 0};   // as given to start_sample()
+    bool branched = false;   // on a split branch: independent numbers only
+    int bounce = 0;
+    uint32_t dimension = 0;
+    double stratified_y = 0.0;   // second coordinate of the current stratified pair
+    uint32_t sobol_group = ~0u;  // group of 4 dimensions whose index/key are cached
+    uint32_t sobol_index = 0;
+    uint64_t sobol_key = 0;
+
+    void start_bounce() {
+        bounce_key = mix64(sample_key ^ (static_cast<uint64_t>(bounce) * 0xBF58476D1CE4E5B9ull));
+        dimension = 0;
+        sobol_group = ~0u;
+    }
+
+    // Per-pixel (not per-sample) key of dimension `d` of the current bounce
+    uint64_t pattern_key(uint32_t d) const {
+        return mix64(pixel_key ^ mix64((static_cast<uint64_t>(bounce) << 32 | d) + 0x632BE59BD9B4E019ull));
+    }
+
+    // SplitMix64 finalizer: a bijective 64-bit avalanche mix.
+    static uint64_t mix64(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // 53 bits of resolution
+    static double uniform(uint64_t key) { return (mix64(key) >> 11) * 0x1.0p-53; }
+
+    // --- Estratificado: correlated multi-jittered (Kensler 2013) por par de dimensões ---
+    // The pixel's samples_per_pixel samples form one exact m x n jittered grid whose
+    // projections are also stratified in 1D; every (bounce, pair) gets its own
+    // shuffle. Sample indices past samples_per_pixel are independent.
+
+    // Pseudo-random permutation of [0, l) (Kensler's hash with cycle walking)
+    static uint32_t permute(uint32_t i, uint32_t l, uint32_t p) {
+        uint32_t w = l - 1;
+        w |= w >> 1; w |= w >> 2; w |= w >> 4; w |= w >> 8; w |= w >> 16;
+        do {
+            i ^= p; i *= 0xe170893d; i ^= p >> 16;
+            i ^= (i & w) >> 4; i ^= p >> 8; i *= 0x0929eb3f;
+            i ^= p >> 23; i ^= (i & w) >> 1; i *= 1 | p >> 27;
+            i *= 0x6935fa69; i ^= (i & w) >> 11; i *= 0x74dcb303;
+            i ^= (i & w) >> 2; i *= 0x9e501cc3; i ^= (i & w) >> 2;
+            i *= 0xc860a3df; i &= w; i ^= i >> 5;
+        } while (i >= l);
+        return (i + p) % l;
+    }
+
+    double stratified(uint32_t d) {
+        if (d & 1) return stratified_y;
+        const uint64_t key = pattern_key(d);
+        const uint32_t p = static_cast<uint32_t>(key);
+        const uint32_t N = samples_per_pixel;
+        const uint32_t m = grid_m, n = grid_n;
+        const uint32_t s = permute(index, N, p * 0x51633e2d);
+        const uint32_t sx = permute(s % m, m, p * 0x68bc21eb);
+        const uint32_t sy = permute(s / m, n, p * 0x02e5be93);
+        const double jx = uniform(key ^ (static_cast<uint64_t>(index) << 1));
+        const double jy = uniform(key ^ (static_cast<uint64_t>(index) << 1 | 1));
+        stratified_y = std::min((s / m + (sx + jy) / m) / n, 0x1.fffffffffffffp-1);
+        return std::min((s % m + (sy + jx) / n) / m, 0x1.fffffffffffffp-1);
+    }
+
+    // --- Halton: inverso radical na base primes[g], g = bounce * 8 + dimensão ---
+    // Cranley-Patterson rotation per pixel and dimension, so neighbouring pixels do
+    // not repeat the same points.
+    double halton(uint32_t g) const {
+        static const uint32_t primes[kHaltonDimensions] = {
+            2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+            59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+            137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+            227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311};
+        const uint32_t base = primes[g];
+        const double inv_base = 1.0 / base;
+        double factor = inv_base, value = 0.0;
+        for (uint32_t i = index; i > 0; i /= base) {
+            value += (i % base) * factor;
+            factor *= inv_base;
+        }
+        value += uniform(pattern_key(g));
+        return value >= 1.0 ? value - 1.0 : value;
+    }
+
+    // --- Sobol com embaralhamento de Owen por hash (Burley 2020) ---
+    // Dimensions go in groups of 4 with their own shuffled sample index ("padding"),
+    // so only the first four Sobol dimensions are needed; each coordinate is then
+    // Owen-scrambled with a per-pixel seed.
+    static uint32_t reverse_bits(uint32_t x) {
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+        x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+        x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+        x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+        return x;
+    }
+
+    static uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+        x = reverse_bits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return reverse_bits(x);
+    }
+
+    // Generator matrices of Sobol dimensions 0-3 (Joe & Kuo direction numbers), built
+    // once and stored as XOR tables, one per byte of the index: 4 lookups per point.
+    struct SobolTables {
+        uint32_t table[4][4][256];
+        SobolTables() {
+            const uint32_t s[4] = {0, 1, 2, 3}, a[4] = {0, 0, 1, 1};
+            const uint32_t m[4][3] = {{0, 0, 0}, {1, 0, 0}, {1, 3, 0}, {1, 3, 1}};
+            uint32_t v[4][32];
+            for (int k = 0; k < 32; ++k) v[0][k] = 1u << (31 - k);
+            for (int d = 1; d < 4; ++d) {
+                for (uint32_t k = 0; k < 32; ++k) {
+                    if (k < s[d]) {
+                        v[d][k] = m[d][k] << (31 - k);
+                        continue;
+                    }
+                    uint32_t x = v[d][k - s[d]] ^ (v[d][k - s[d]] >> s[d]);
+                    for (uint32_t j = 1; j < s[d]; ++j)
+                        if ((a[d] >> (s[d] - 1 - j)) & 1) x ^= v[d][k - j];
+                    v[d][k] = x;
+                }
+            }
+            for (int d = 0; d < 4; ++d) {
+                for (int byte = 0; byte < 4; ++byte) {
+                    for (uint32_t b = 0; b < 256; ++b) {
+                        uint32_t x = 0;
+                        for (int k = 0; k < 8; ++k)
+                            if ((b >> k) & 1) x ^= v[d][8 * byte + k];
+                        table[d][byte][b] = x;
+                    }
+                }
+            }
+        }
+    };
+
+    double sobol(uint32_t d) {
+        static const SobolTables tables;
+        // Índice embaralhado e semente: uma vez por grupo de 4 dimensões
+        if ((d >> 2) != sobol_group) {
+            sobol_group = d >> 2;
+            sobol_key = pattern_key(d & ~3u);
+            sobol_index = nested_uniform_scramble(index, static_cast<uint32_t>(sobol_key));
+        }
+        const uint32_t (*t)[256] = tables.table[d & 3];
+        const uint32_t i = sobol_index;
+        uint32_t x = t[0][i & 0xff] ^ t[1][(i >> 8) & 0xff] ^ t[2][(i >> 16) & 0xff] ^ t[3][i >> 24];
+        x = nested_uniform_scramble(x, static_cast<uint32_t>(mix64(sobol_key + (d & 3))));
+        return x * 0x1.0p-32;
+    }
+};
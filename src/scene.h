@@ -0,0 +1,22 @@
+#pragma once
+#include "hittable_list.h"
+#include "material.h"
+#include "lights.h"
+#include <memory>
+
+// Everything the integrator needs to trace the scene: the materials table and the
+// geometry. `objects` is what main.cpp builds; `accel` (usually the BVH) is what
+// rays are traced against once it has been built. `lights` is collected from
+// `objects` by build_light_list() before rendering.
+struct Scene {
+    MaterialTable materials;
+    HittableList objects;
+    std::shared_ptr<Hittable> accel;
+    LightList lights;
+
+    const Hittable& world() const {
+        if (accel) return *accel;
+        return objects;
+    }
+    const Material& material(const HitRecord& rec) const { return materials[rec.mat_id]; }
+};
@@ -0,0 +1,294 @@
+#pragma once
+#include "scene.h"
+#include "scene_file.h"
+#include "bvh.h"
+#include "lights.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PT_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Compiled scene cache: the flattened primitive records in BVH leaf order, the
+// material records, the transforms of the rotated boxes and the BVH node array,
+// written as one binary file:
+//
+//   SceneCacheHeader | MaterialDesc[materials] | PrimitiveDesc[primitives] | Transform[transforms] | BVHNode[nodes]
+//
+// Every record is plain data with 8-byte alignment, so a later run maps the file
+// and traces straight out of the mapping: no parsing and no BVH build.
+
+// Read-only view of a whole file; mmap where available, a heap copy otherwise.
+class MappedFile {
+public:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+
+    static std::shared_ptr<MappedFile> open(const std::string& path) {
+        auto file = std::shared_ptr<MappedFile>(new MappedFile());
+#ifdef PT_HAVE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return nullptr;
+        }
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return nullptr;
+        file->data = static_cast<const unsigned char*>(p);
+        file->size = static_cast<size_t>(st.st_size);
+        file->mapped = true;
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return nullptr;
+        file->copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        file->data = file->copy.data();
+        file->size = file->copy.size();
+#endif
+        return file;
+    }
+
+    ~MappedFile() {
+#ifdef PT_HAVE_MMAP
+        if (mapped) munmap(const_cast<unsigned char*>(data), size);
+#endif
+    }
+
+private:
+    MappedFile() {}
+    bool mapped = false;
+    std::vector<unsigned char> copy;
+};
+
+struct SceneCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t real_size;  // sizeof(Real) of the build that wrote it: records are not portable
+    uint32_t pad;
+    // Size and modification time of the scene file it was compiled from
+    uint64_t source_size;
+    int64_t source_mtime;
+    CameraDesc camera;
+    uint64_t material_count;
+    uint64_t primitive_count;
+    uint64_t transform_count;
+    uint64_t node_count;
+};
+
+static_assert(std::is_trivially_copyable<SceneCacheHeader>::value, "SceneCacheHeader is written as is");
+static_assert(std::is_trivially_copyable<Transform>::value, "Transform is stored in scene caches");
+static_assert(sizeof(SceneCacheHeader) % 8 == 0 && sizeof(MaterialDesc) % 8 == 0 && sizeof(PrimitiveDesc) % 8 == 0 &&
+              sizeof(Transform) % 8 == 0 && sizeof(BVHNode) % 8 == 0, "cache records must stay 8-byte aligned");
+
+constexpr char kSceneCacheMagic[4] = {'P', 'T', 'S', 'C'};
+constexpr uint32_t kSceneCacheVersion = 3;
+
+inline bool scene_source_stat(const std::string& path, uint64_t& size, int64_t& mtime) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    size = static_cast<uint64_t>(st.st_size);
+    mtime = static_cast<int64_t>(st.st_mtime);
+    return true;
+}
+
+inline Box box_of(const PrimitiveDesc& p) {
+    return Box(Vec3(p.v[0], p.v[1], p.v[2]), Vec3(p.v[3], p.v[4], p.v[5]), p.mat);
+}
+
+// The concrete types are known here, so these calls are not virtual. A rotated box
+// is an instance of its Box with the Transform compiled into the cache.
+inline bool hit_primitive(const PrimitiveDesc& p, const Transform* transforms, const Ray& r, Real t_min, Real t_max,
+                          HitRecord& rec) {
+    const Real* v = p.v;
+    switch (p.kind) {
+        case PrimitiveDesc::RectXY: return XYRect(v[0], v[1], v[2], v[3], v[4], p.mat).hit(r, t_min, t_max, rec);
+        case PrimitiveDesc::RectXZ: return XZRect(v[0], v[1], v[2], v[3], v[4], p.mat).hit(r, t_min, t_max, rec);
+        case PrimitiveDesc::RectYZ: return YZRect(v[0], v[1], v[2], v[3], v[4], p.mat).hit(r, t_min, t_max, rec);
+        case PrimitiveDesc::RectXZDoubleSided:
+            return DoubleSidedXZRect(v[0], v[1], v[2], v[3], v[4], p.mat).hit(r, t_min, t_max, rec);
+        case PrimitiveDesc::SphereKind: return Sphere(Vec3(v[0], v[1], v[2]), v[3], p.mat).hit(r, t_min, t_max, rec);
+        case PrimitiveDesc::BoxKind: return box_of(p).hit(r, t_min, t_max, rec);
+        default: return hit_instance(box_of(p), transforms[p.transform], r, t_min, t_max, rec);
+    }
+}
+
+inline bool occluded_primitive(const PrimitiveDesc& p, const Transform* transforms, const Ray& r, Real t_min, Real t_max) {
+    switch (p.kind) {
+        case PrimitiveDesc::SphereKind: return Sphere(Vec3(p.v[0], p.v[1], p.v[2]), p.v[3], p.mat).occluded(r, t_min, t_max);
+        case PrimitiveDesc::BoxKind: return box_of(p).occluded(r, t_min, t_max);
+        case PrimitiveDesc::RotatedBoxKind:
+            return box_of(p).occluded(transforms[p.transform].ray_to_object(r), t_min, t_max);
+        default: {
+            HitRecord rec;
+            return hit_primitive(p, transforms, r, t_min, t_max, rec);
+        }
+    }
+}
+
+// Geometry traced directly from a mapped cache file.
+class CompiledScene : public Hittable {
+public:
+    std::shared_ptr<MappedFile> file;  // keeps the mapping alive
+    const PrimitiveDesc* primitives = nullptr;
+    size_t primitive_count = 0;
+    const Transform* transforms = nullptr;
+    const BVHNode* nodes = nullptr;
+    size_t node_count = 0;
+
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
+        return bvh_traverse(nodes, node_count, r, t_min, t_max, rec,
+                            [&](int i, Real closest, HitRecord& temp) { return hit_primitive(primitives[i], transforms, r, t_min, closest, temp); });
+    }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        return bvh_occluded(nodes, node_count, r, t_min, t_max,
+                            [&](int i) { return occluded_primitive(primitives[i], transforms, r, t_min, t_max); });
+    }
+
+    virtual void hit_packet(const RayPacket& packet, uint64_t active, PacketHits& hits) const override {
+        bvh_traverse_packet(nodes, node_count, packet, active, hits, [&](int i, uint64_t mask) {
+            HitRecord temp;
+            for (; mask; mask &= mask - 1) {
+                int r = __builtin_ctzll(mask);
+                if (hit_primitive(primitives[i], transforms, packet.ray(r), 0, hits.t[r], temp)) hits.record(r, temp);
+            }
+        });
+    }
+
+    virtual AABB bounding_box() const override {
+        return node_count > 0 ? nodes[0].bounds : AABB();
+    }
+};
+
+// Builds the BVH over the description and writes the cache (via a temporary file,
+// like checkpoints). `source_path` is recorded so stale caches can be detected.
+inline bool write_scene_cache(const std::string& path, const std::string& source_path, const SceneDescription& desc) {
+    HittableList objects;
+    for (const PrimitiveDesc& p : desc.primitives) objects.add(make_hittable(p));
+    BVH bvh(objects);
+    bvh.print_build_stats(std::cerr);
+
+    SceneCacheHeader h{};   // zera também o preenchimento: o cabeçalho vai para o disco como está
+    h.pad = 0;
+    std::memcpy(h.magic, kSceneCacheMagic, 4);
+    h.version = kSceneCacheVersion;
+    h.real_size = sizeof(Real);
+    scene_source_stat(source_path, h.source_size, h.source_mtime);
+    h.camera = desc.camera;
+    h.material_count = desc.materials.size();
+    h.primitive_count = desc.primitives.size();
+    h.node_count = bvh.node_array().size();
+
+    // As matrizes das caixas rotacionadas são calculadas aqui, uma vez
+    std::vector<PrimitiveDesc> ordered;
+    std::vector<Transform> transforms;
+    ordered.reserve(desc.primitives.size());
+    for (uint32_t index : bvh.primitive_order()) {
+        PrimitiveDesc p = desc.primitives[index];
+        if (p.kind == PrimitiveDesc::RotatedBoxKind) {
+            p.transform = static_cast<uint32_t>(transforms.size());
+            transforms.push_back(RotatedBox::about_center(Vec3(p.v[0], p.v[1], p.v[2]), Vec3(p.v[3], p.v[4], p.v[5]),
+                                                          rotated_box_angle(p)));
+        }
+        ordered.push_back(p);
+    }
+    h.transform_count = transforms.size();
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(desc.materials.data()), static_cast<std::streamsize>(desc.materials.size() * sizeof(MaterialDesc)));
+        out.write(reinterpret_cast<const char*>(ordered.data()), static_cast<std::streamsize>(ordered.size() * sizeof(PrimitiveDesc)));
+        out.write(reinterpret_cast<const char*>(transforms.data()), static_cast<std::streamsize>(transforms.size() * sizeof(Transform)));
+        out.write(reinterpret_cast<const char*>(bvh.node_array().data()), static_cast<std::streamsize>(h.node_count * sizeof(BVHNode)));
+        if (!out) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// Maps a cache into `scene` (materials, lights, accel). With a non-empty
+// `source_path` the cache is rejected if that file changed since it was compiled.
+inline bool load_scene_cache(const std::string& path, const std::string& source_path, Scene& scene, CameraDesc& camera) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (!file) return false;
+
+    SceneCacheHeader h;
+    if (file->size < sizeof(h)) return false;
+    std::memcpy(&h, file->data, sizeof(h));
+    if (std::memcmp(h.magic, kSceneCacheMagic, 4) != 0 || h.version != kSceneCacheVersion) {
+        std::cerr << "Not a scene cache: " << path << '\n';
+        return false;
+    }
+    if (h.real_size != sizeof(Real)) {
+        std::cerr << "Scene cache " << path << " was written by a " << (h.real_size == sizeof(float) ? "float" : "double")
+                  << " build\n";
+        return false;
+    }
+    size_t expected = sizeof(h) + h.material_count * sizeof(MaterialDesc) + h.primitive_count * sizeof(PrimitiveDesc) +
+                      h.transform_count * sizeof(Transform) + h.node_count * sizeof(BVHNode);
+    if (file->size != expected) {
+        std::cerr << "Truncated scene cache " << path << '\n';
+        return false;
+    }
+    uint64_t size;
+    int64_t mtime;
+    if (!source_path.empty() && scene_source_stat(source_path, size, mtime) &&
+        (size != h.source_size || mtime != h.source_mtime)) {
+        std::cerr << "Scene cache " << path << " is older than " << source_path << '\n';
+        return false;
+    }
+
+    const unsigned char* p = file->data + sizeof(h);
+    const MaterialDesc* materials = reinterpret_cast<const MaterialDesc*>(p);
+    p += h.material_count * sizeof(MaterialDesc);
+    auto compiled = std::make_shared<CompiledScene>();
+    compiled->primitives = reinterpret_cast<const PrimitiveDesc*>(p);
+    compiled->primitive_count = h.primitive_count;
+    p += h.primitive_count * sizeof(PrimitiveDesc);
+    compiled->transforms = reinterpret_cast<const Transform*>(p);
+    p += h.transform_count * sizeof(Transform);
+    compiled->nodes = reinterpret_cast<const BVHNode*>(p);
+    compiled->node_count = h.node_count;
+    compiled->file = file;
+
+    for (size_t i = 0; i < compiled->primitive_count; ++i) {
+        const PrimitiveDesc& prim = compiled->primitives[i];
+        if (prim.mat >= h.material_count || (prim.kind == PrimitiveDesc::RotatedBoxKind && prim.transform >= h.transform_count)) {
+            std::cerr << "Corrupt scene cache " << path << '\n';
+            return false;
+        }
+    }
+
+    SceneDescription materials_only;
+    materials_only.materials.assign(materials, materials + h.material_count);
+    add_materials(materials_only, scene.materials);
+
+    // Only the emitters become objects, to collect the light list
+    HittableList emitters;
+    for (size_t i = 0; i < compiled->primitive_count; ++i) {
+        const PrimitiveDesc& prim = compiled->primitives[i];
+        if (materials[prim.mat].kind == MaterialDesc::Light)
+            emitters.add(make_hittable(prim));
+    }
+    scene.lights = build_light_list(emitters, scene.materials);
+
+    scene.objects.clear();
+    scene.accel = compiled;
+    camera = h.camera;
+    return true;
+}
@@ -0,0 +1,226 @@
+#pragma once
+#include "scene.h"
+#include "camera.h"
+#include "rectangle.h"
+#include "sphere.h"
+#include "rotated_box.h"
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Scene description files. One statement per line, '#' starts a comment:
+//
+//   camera <from x y z> <at x y z> <vup x y z> <vfov>
+//   material <name> lambertian <r g b>
+//   material <name> light <r g b>
+//   rect <xy|xz|yz|xz2> <a0 a1 b0 b1 k> <material>    # xz2 = DoubleSidedXZRect
+//   sphere <cx cy cz> <radius> <material>
+//   box <x0 y0 z0> <x1 y1 z1> <material>
+//   rotated_box <x0 y0 z0> <x1 y1 z1> <angle em graus, eixo y> <material>
+//   light rect <xy|xz|yz|xz2> <a0 a1 b0 b1 k> <r g b>   # emissor com material próprio
+//   light sphere <cx cy cz> <radius> <r g b>
+//
+// Rect extents follow the class constructors (XYRect: x0 x1 y0 y1 z, ...).
+
+struct CameraDesc {
+    Vec3 lookfrom = Vec3(278, 278, -800);
+    Vec3 lookat = Vec3(278, 278, 0);
+    Vec3 vup = Vec3(0, 1, 0);
+    Real vfov = 40.0;
+
+    Camera make(Real aspect_ratio) const { return Camera(lookfrom, lookat, vup, vfov, aspect_ratio); }
+};
+
+// Plain-data material and primitive records. The parser produces them and the
+// binary scene cache (scene_cache.h) stores them unchanged.
+struct MaterialDesc {
+    enum Kind : uint32_t { Lambertian = 0, Light = 1 };
+    uint32_t kind;
+    uint32_t pad;
+    double color[3];
+};
+
+struct PrimitiveDesc {
+    enum Kind : uint32_t { RectXY = 0, RectXZ, RectYZ, RectXZDoubleSided, SphereKind, RotatedBoxKind, BoxKind };
+    uint32_t kind;
+    MaterialId mat;
+    uint32_t transform;  // RotatedBox: index of its Transform in a scene cache (scene_cache.h)
+    uint32_t pad;
+    // Rects: a0 a1 b0 b1 k. Sphere: cx cy cz r. Box: p0, p1. RotatedBox: p0, p1, sin, cos.
+    Real v[8];
+};
+
+static_assert(std::is_trivially_copyable<MaterialDesc>::value, "stored in scene caches");
+static_assert(std::is_trivially_copyable<PrimitiveDesc>::value, "stored in scene caches");
+
+struct SceneDescription {
+    CameraDesc camera;
+    std::vector<MaterialDesc> materials;
+    std::vector<PrimitiveDesc> primitives;
+};
+
+inline PrimitiveDesc make_rect_desc(uint32_t kind, Real a0, Real a1, Real b0, Real b1, Real k, MaterialId mat) {
+    PrimitiveDesc p = {kind, mat, 0, 0, {a0, a1, b0, b1, k, 0, 0, 0}};
+    return p;
+}
+
+// Rotation of a RotatedBox record in degrees, as RotatedBox takes it
+inline Real rotated_box_angle(const PrimitiveDesc& p) {
+    return std::atan2(p.v[6], p.v[7]) * 180.0 / M_PI;
+}
+
+// Parses a scene file. Errors are reported as "file:line: message" on stderr.
+inline bool load_scene_file(const std::string& path, SceneDescription& desc) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Could not open scene " << path << '\n';
+        return false;
+    }
+
+    std::map<std::string, MaterialId> names;
+    std::string line;
+    int line_number = 0;
+    auto fail = [&](const std::string& message) {
+        std::cerr << path << ":" << line_number << ": " << message << '\n';
+        return false;
+    };
+    auto add_material = [&](uint32_t kind, const Vec3& c) {
+        desc.materials.push_back({kind, 0, {c.x, c.y, c.z}});
+        return static_cast<MaterialId>(desc.materials.size() - 1);
+    };
+    auto rect_kind = [](const std::string& axes, uint32_t& kind) {
+        if (axes == "xy") kind = PrimitiveDesc::RectXY;
+        else if (axes == "xz") kind = PrimitiveDesc::RectXZ;
+        else if (axes == "yz") kind = PrimitiveDesc::RectYZ;
+        else if (axes == "xz2") kind = PrimitiveDesc::RectXZDoubleSided;
+        else return false;
+        return true;
+    };
+
+    while (std::getline(in, line)) {
+        ++line_number;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream ls(line);
+        std::string keyword;
+        if (!(ls >> keyword)) continue;
+
+        auto read_vec = [&](Vec3& v) { return static_cast<bool>(ls >> v.x >> v.y >> v.z); };
+        auto read_material = [&](MaterialId& mat) {
+            std::string name;
+            if (!(ls >> name)) return false;
+            auto it = names.find(name);
+            if (it == names.end()) return false;
+            mat = it->second;
+            return true;
+        };
+
+        if (keyword == "camera") {
+            CameraDesc& c = desc.camera;
+            if (!read_vec(c.lookfrom) || !read_vec(c.lookat) || !read_vec(c.vup) || !(ls >> c.vfov))
+                return fail("expected: camera <from xyz> <at xyz> <vup xyz> <vfov>");
+        } else if (keyword == "material") {
+            std::string name, type;
+            Vec3 color;
+            if (!(ls >> name >> type) || !read_vec(color))
+                return fail("expected: material <name> <lambertian|light> <r g b>");
+            if (type == "lambertian") names[name] = add_material(MaterialDesc::Lambertian, color);
+            else if (type == "light") names[name] = add_material(MaterialDesc::Light, color);
+            else return fail("unknown material type '" + type + "'");
+        } else if (keyword == "rect") {
+            std::string axes;
+            Real a0, a1, b0, b1, k;
+            MaterialId mat;
+            uint32_t kind;
+            if (!(ls >> axes >> a0 >> a1 >> b0 >> b1 >> k)) return fail("expected: rect <xy|xz|yz|xz2> <a0 a1 b0 b1 k> <material>");
+            if (!rect_kind(axes, kind)) return fail("unknown rect orientation '" + axes + "'");
+            if (!read_material(mat)) return fail("missing or undefined material");
+            desc.primitives.push_back(make_rect_desc(kind, a0, a1, b0, b1, k, mat));
+        } else if (keyword == "sphere") {
+            Vec3 c;
+            Real r;
+            MaterialId mat;
+            if (!read_vec(c) || !(ls >> r)) return fail("expected: sphere <cx cy cz> <radius> <material>");
+            if (!read_material(mat)) return fail("missing or undefined material");
+            desc.primitives.push_back({PrimitiveDesc::SphereKind, mat, 0, 0, {c.x, c.y, c.z, r, 0, 0, 0, 0}});
+        } else if (keyword == "box" || keyword == "rotated_box") {
+            Vec3 p0, p1;
+            double angle = 0.0;
+            MaterialId mat;
+            if (!read_vec(p0) || !read_vec(p1) || (keyword == "rotated_box" && !(ls >> angle)))
+                return fail("expected: " + keyword + " <x0 y0 z0> <x1 y1 z1>" + (keyword == "box" ? "" : " <angle>") + " <material>");
+            if (!read_material(mat)) return fail("missing or undefined material");
+            if (keyword == "box") {
+                desc.primitives.push_back({PrimitiveDesc::BoxKind, mat, 0, 0, {p0.x, p0.y, p0.z, p1.x, p1.y, p1.z, 0, 0}});
+            } else {
+                double radians = angle * M_PI / 180.0;
+                desc.primitives.push_back({PrimitiveDesc::RotatedBoxKind, mat, 0, 0,
+                                           {p0.x, p0.y, p0.z, p1.x, p1.y, p1.z, static_cast<Real>(std::sin(radians)), static_cast<Real>(std::cos(radians))}});
+            }
+        } else if (keyword == "light") {
+            std::string shape;
+            ls >> shape;
+            if (shape == "rect") {
+                std::string axes;
+                Real a0, a1, b0, b1, k;
+                uint32_t kind;
+                Vec3 emission;
+                if (!(ls >> axes >> a0 >> a1 >> b0 >> b1 >> k) || !read_vec(emission))
+                    return fail("expected: light rect <xy|xz|yz|xz2> <a0 a1 b0 b1 k> <r g b>");
+                if (!rect_kind(axes, kind)) return fail("unknown rect orientation '" + axes + "'");
+                desc.primitives.push_back(make_rect_desc(kind, a0, a1, b0, b1, k, add_material(MaterialDesc::Light, emission)));
+            } else if (shape == "sphere") {
+                Vec3 c, emission;
+                Real r;
+                if (!read_vec(c) || !(ls >> r) || !read_vec(emission))
+                    return fail("expected: light sphere <cx cy cz> <radius> <r g b>");
+                desc.primitives.push_back({PrimitiveDesc::SphereKind, add_material(MaterialDesc::Light, emission), 0, 0,
+                                           {c.x, c.y, c.z, r, 0, 0, 0, 0}});
+            } else {
+                return fail("expected: light <rect|sphere> ...");
+            }
+        } else {
+            return fail("unknown statement '" + keyword + "'");
+        }
+
+        std::string extra;
+        if (ls >> extra) return fail("unexpected '" + extra + "'");
+    }
+    return true;
+}
+
+inline void add_materials(const SceneDescription& desc, MaterialTable& materials) {
+    for (const MaterialDesc& m : desc.materials) {
+        Vec3 color(m.color[0], m.color[1], m.color[2]);
+        if (m.kind == MaterialDesc::Light) materials.add<DiffuseLight>(color);
+        else materials.add<Lambertian>(color);
+    }
+}
+
+// Object form of one primitive record, for the regular (non-cached) path.
+inline std::shared_ptr<Hittable> make_hittable(const PrimitiveDesc& p) {
+    const Real* v = p.v;
+    switch (p.kind) {
+        case PrimitiveDesc::RectXY: return std::make_shared<XYRect>(v[0], v[1], v[2], v[3], v[4], p.mat);
+        case PrimitiveDesc::RectXZ: return std::make_shared<XZRect>(v[0], v[1], v[2], v[3], v[4], p.mat);
+        case PrimitiveDesc::RectYZ: return std::make_shared<YZRect>(v[0], v[1], v[2], v[3], v[4], p.mat);
+        case PrimitiveDesc::RectXZDoubleSided: return std::make_shared<DoubleSidedXZRect>(v[0], v[1], v[2], v[3], v[4], p.mat);
+        case PrimitiveDesc::SphereKind: return std::make_shared<Sphere>(Vec3(v[0], v[1], v[2]), v[3], p.mat);
+        case PrimitiveDesc::BoxKind: return std::make_shared<Box>(Vec3(v[0], v[1], v[2]), Vec3(v[3], v[4], v[5]), p.mat);
+        default:
+            return std::make_shared<RotatedBox>(Vec3(v[0], v[1], v[2]), Vec3(v[3], v[4], v[5]), p.mat, rotated_box_angle(p));
+    }
+}
+
+// Fills scene.materials and scene.objects; the caller builds lights and the BVH as usual.
+inline void build_scene(const SceneDescription& desc, Scene& scene) {
+    add_materials(desc, scene.materials);
+    for (const PrimitiveDesc& p : desc.primitives)
+        scene.objects.add(make_hittable(p));
+}
@@ -0,0 +1,313 @@
+#pragma once
+#include "vec3.h"
+#include "aabb.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// SD-tree for path guiding (--guiding), after Müller et al. 2017, "Practical Path
+// Guiding": a binary tree over space whose leaves hold a quadtree over directions.
+// Directions live on the unit square through the cylindrical map (cos theta, phi),
+// which preserves area, so a density on the square is 4*pi times the solid-angle pdf.
+//
+// Each leaf keeps two quadtrees: `sampling`, learned in the previous pass and
+// read-only while rendering, and `building`, which the current pass records into.
+// Recording is a lock-free float add into one quadtree leaf; the interior sums,
+// the spatial splits and the refined quadtrees are all computed between passes.
+
+namespace guiding_detail {
+
+inline void atomic_add(float& target, float value) {
+    float expected, desired;
+    __atomic_load(&target, &expected, __ATOMIC_RELAXED);
+    do {
+        desired = expected + value;
+    } while (!__atomic_compare_exchange(&target, &expected, &desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+inline float luminance(const Vec3& c) {
+    return static_cast<float>(0.2126 * c.x + 0.7152 * c.y + 0.0722 * c.z);
+}
+
+inline Vec3 square_to_direction(double x, double y) {
+    double cos_theta = 2 * x - 1;
+    double sin_theta = std::sqrt(std::max(0.0, 1 - cos_theta * cos_theta));
+    double phi = 2 * M_PI * y;
+    return Vec3(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+}
+
+inline void direction_to_square(const Vec3& d, double& x, double& y) {
+    x = std::clamp((static_cast<double>(d.z) + 1) * 0.5, 0.0, 1.0);
+    double phi = std::atan2(static_cast<double>(d.y), static_cast<double>(d.x));
+    if (phi < 0) phi += 2 * M_PI;
+    y = std::clamp(phi / (2 * M_PI), 0.0, 1.0);
+}
+
+} // namespace guiding_detail
+
+// Quadtree over the direction square. Quadrant c of a node covers x in the half
+// (c & 1) and y in the half (c >> 1); sum[c] is the energy recorded below it.
+class DTree {
+public:
+    struct Node {
+        float sum[4] = {0, 0, 0, 0};
+        uint32_t child[4] = {0, 0, 0, 0};   // 0 = quadrante folha (a raiz nunca é filha)
+    };
+    std::vector<Node> nodes;
+
+    DTree() : nodes(1) {}
+
+    float total() const { return nodes[0].sum[0] + nodes[0].sum[1] + nodes[0].sum[2] + nodes[0].sum[3]; }
+
+    // Thread-safe: only the leaf quadrant's sum is touched
+    void record(double x, double y, float value) {
+        uint32_t n = 0;
+        while (true) {
+            int c = quadrant(x, y);
+            if (nodes[n].child[c] == 0) {
+                guiding_detail::atomic_add(nodes[n].sum[c], value);
+                return;
+            }
+            n = nodes[n].child[c];
+        }
+    }
+
+    // Fills the interior sums from the leaves after a pass; returns the total
+    float accumulate(uint32_t n = 0) {
+        Node& node = nodes[n];
+        float total = 0.0f;
+        for (int c = 0; c < 4; ++c) {
+            if (node.child[c] != 0) node.sum[c] = accumulate(node.child[c]);
+            total += node.sum[c];
+        }
+        return total;
+    }
+
+    void scale(float factor) {
+        for (Node& node : nodes)
+            for (float& s : node.sum) s *= factor;
+    }
+
+    // Density on the square of the point (x, y); 0 if nothing was recorded. After
+    // accumulate() each sum is exactly its child's total, so the product of the
+    // per-level ratios 4 * sum[c] / total telescopes to 4^depth * leaf sum / root total.
+    double pdf(double x, double y) const {
+        const float root_total = total();
+        if (!(root_total > 0.0f)) return 0.0;
+        double area_scale = 4.0 / root_total;
+        uint32_t n = 0;
+        while (true) {
+            int c = quadrant(x, y);
+            const Node& node = nodes[n];
+            if (node.child[c] == 0) return node.sum[c] * area_scale;
+            n = node.child[c];
+            area_scale *= 4.0;
+        }
+    }
+
+    // Point on the square with density pdf(), from (u, v) in [0, 1)^2. The random
+    // numbers are reused level by level: first the column, then the row. Each is
+    // kept as a fraction num / den so that descending costs no divisions.
+    void sample(double u, double v, double& x, double& y) const {
+        double u_num = u, u_den = 1.0, v_num = v, v_den = 1.0;
+        double origin_x = 0.0, origin_y = 0.0, size = 1.0;
+        uint32_t n = 0;
+        while (true) {
+            // Sem desvios: a escolha da metade é imprevisível
+            const Node& node = nodes[n];
+            const double left = node.sum[0] + node.sum[2], right = node.sum[1] + node.sum[3];
+            const int cx = u_num * (left + right) >= left * u_den;
+            u_num = u_num * (left + right) - cx * left * u_den;
+            u_den *= left + cx * (right - left);
+            const double bottom = node.sum[cx], top = node.sum[cx + 2];
+            const int cy = v_num * (bottom + top) >= bottom * v_den;
+            v_num = v_num * (bottom + top) - cy * bottom * v_den;
+            v_den *= bottom + cy * (top - bottom);
+            size *= 0.5;
+            origin_x += cx * size;
+            origin_y += cy * size;
+            const int c = cx + 2 * cy;
+            if (node.child[c] == 0) {
+                x = origin_x + std::min(u_num / u_den, 0.999999) * size;
+                y = origin_y + std::min(v_num / v_den, 0.999999) * size;
+                return;
+            }
+            n = node.child[c];
+        }
+    }
+
+    // New, empty structure for the next pass: a quadrant is subdivided while it holds
+    // more than `fraction` of this tree's energy (unseen children get equal shares).
+    DTree refined(double fraction, int max_depth) const {
+        DTree out;
+        const double threshold = fraction * total();
+        if (!(threshold > 0.0)) return out;
+        struct Item {
+            uint32_t out_node;
+            int64_t old_node;   // -1: below this tree's leaves
+            float energy;       // of the quadrant this node splits (for old_node == -1)
+            int depth;
+        };
+        std::vector<Item> stack = {{0, 0, total(), 1}};
+        while (!stack.empty()) {
+            Item item = stack.back();
+            stack.pop_back();
+            for (int c = 0; c < 4; ++c) {
+                const float e = item.old_node >= 0 ? nodes[item.old_node].sum[c] : item.energy * 0.25f;
+                if (!(e > threshold) || item.depth >= max_depth) continue;
+                const uint32_t child = static_cast<uint32_t>(out.nodes.size());
+                out.nodes.emplace_back();
+                out.nodes[item.out_node].child[c] = child;
+                const int64_t old_child = item.old_node >= 0 && nodes[item.old_node].child[c] != 0
+                                              ? static_cast<int64_t>(nodes[item.old_node].child[c]) : -1;
+                stack.push_back({child, old_child, e, item.depth + 1});
+            }
+        }
+        return out;
+    }
+
+private:
+    // Quadrant of (x, y), rescaling the point to that quadrant
+    static int quadrant(double& x, double& y) {
+        const int cx = x >= 0.5, cy = y >= 0.5;
+        x = 2 * x - cx;
+        y = 2 * y - cy;
+        return cx | (cy << 1);
+    }
+};
+
+// Spatial binary tree over the scene's bounding cube, split in x, y, z order.
+class SDTree {
+public:
+    struct Leaf {
+        DTree sampling;
+        DTree building;
+        uint32_t samples = 0;   // records of the current pass (atomic)
+
+        bool can_sample() const { return sampling.total() > 0.0f; }
+
+        // Solid-angle pdf of the unit direction `d`
+        double pdf(const Vec3& d) const {
+            double x, y;
+            guiding_detail::direction_to_square(d, x, y);
+            return sampling.pdf(x, y) / (4 * M_PI);
+        }
+
+        // Direction from (u, v) and its solid-angle pdf (read at the sampled point
+        // of the square, which saves mapping the direction back)
+        Vec3 sample(double u, double v, double& pdf_out) const {
+            double x, y;
+            sampling.sample(u, v, x, y);
+            pdf_out = sampling.pdf(x, y) / (4 * M_PI);
+            return guiding_detail::square_to_direction(x, y);
+        }
+
+        // Incident radiance (luminance) arriving along `d`, divided by the pdf it was sampled with
+        void record(const Vec3& d, float value) {
+            if (!(value > 0.0f) || !std::isfinite(value)) return;
+            double x, y;
+            guiding_detail::direction_to_square(d, x, y);
+            building.record(x, y, value);
+            __atomic_fetch_add(&samples, 1u, __ATOMIC_RELAXED);
+        }
+    };
+
+    // Parâmetros do artigo: split espacial com c * sqrt(2^k) amostras, quadtree com 1% da energia
+    static constexpr double kSpatialThreshold = 12000.0;
+    static constexpr double kDirectionalFraction = 0.01;
+    static constexpr int kMaxDirectionalDepth = 20;
+    static constexpr int kMaxSpatialDepth = 48;
+    // Probabilidade de amostrar a quadtree em vez da BSDF (o artigo usa 0,5; na
+    // Cornell box com a luz escondida 0,25 deu menos ruído por amostra)
+    static constexpr double kGuideFraction = 0.25;
+
+    bool recording = true;   // false na passada final: só amostra
+
+    explicit SDTree(const AABB& scene_bounds) {
+        // Cubo com o maior lado da cena, levemente ampliado
+        Vec3 extent = scene_bounds.maximum - scene_bounds.minimum;
+        Real side = std::max(extent.x, std::max(extent.y, extent.z)) * Real(1.001) + Real(1e-3);
+        Vec3 center = (scene_bounds.minimum + scene_bounds.maximum) * Real(0.5);
+        origin = center - Vec3(side, side, side) * Real(0.5);
+        size = side;
+        nodes.push_back({{0, 0}, 0});
+        leaves.emplace_back();
+    }
+
+    size_t leaf_count() const { return leaves.size(); }
+    size_t node_count() const { return nodes.size(); }
+    size_t directional_node_count() const {
+        size_t n = 0;
+        for (const Leaf& l : leaves) n += l.sampling.nodes.size();
+        return n;
+    }
+
+    Leaf& leaf(const Vec3& p) {
+        double q[3] = {(p.x - origin.x) / size, (p.y - origin.y) / size, (p.z - origin.z) / size};
+        for (double& c : q) c = std::clamp(c, 0.0, 1.0);
+        uint32_t n = 0;
+        int axis = 0;
+        while (nodes[n].child[0] != 0) {
+            // Filho 0 = metade inferior do eixo; a coordenada é reescalada para a metade
+            int side = q[axis] >= 0.5 ? 1 : 0;
+            q[axis] = q[axis] * 2 - side;
+            n = nodes[n].child[side];
+            axis = (axis + 1) % 3;
+        }
+        return leaves[nodes[n].leaf];
+    }
+
+    // Between passes: splits the leaves that saw more than kSpatialThreshold *
+    // sqrt(pass_samples) records, then makes each leaf's recorded quadtree the sampling
+    // one and a refined, empty copy of it the building one.
+    void refine(int pass_samples) {
+        const double threshold = kSpatialThreshold * std::sqrt(static_cast<double>(std::max(pass_samples, 1)));
+        for (Leaf& l : leaves) l.building.accumulate();
+        struct Item {
+            uint32_t node;
+            int depth;
+        };
+        std::vector<Item> stack = {{0, 0}};
+        while (!stack.empty()) {
+            Item item = stack.back();
+            stack.pop_back();
+            if (nodes[item.node].child[0] != 0) {
+                for (uint32_t child : nodes[item.node].child) stack.push_back({child, item.depth + 1});
+                continue;
+            }
+            Leaf& l = leaves[nodes[item.node].leaf];
+            if (l.samples <= threshold || item.depth >= kMaxSpatialDepth) continue;
+            // Cada metade herda a quadtree do pai com metade da energia e das amostras
+            Leaf half = l;
+            half.building.scale(0.5f);
+            half.samples = l.samples / 2;
+            const uint32_t first = static_cast<uint32_t>(nodes.size());
+            const uint32_t second_leaf = static_cast<uint32_t>(leaves.size());
+            nodes.push_back({{0, 0}, nodes[item.node].leaf});
+            nodes.push_back({{0, 0}, second_leaf});
+            leaves[nodes[item.node].leaf] = half;
+            leaves.push_back(half);
+            nodes[item.node].child[0] = first;
+            nodes[item.node].child[1] = first + 1;
+            stack.push_back({first, item.depth + 1});
+            stack.push_back({first + 1, item.depth + 1});
+        }
+        for (Leaf& l : leaves) {
+            // Folha sem registros nesta passada mantém a distribuição anterior
+            if (l.building.total() > 0.0f) l.sampling = l.building;
+            l.building = l.sampling.refined(kDirectionalFraction, kMaxDirectionalDepth);
+            l.samples = 0;
+        }
+    }
+
+private:
+    struct Node {
+        uint32_t child[2];   // 0 = folha
+        uint32_t leaf;
+    };
+    std::vector<Node> nodes;
+    std::vector<Leaf> leaves;
+    Vec3 origin;
+    double size = 1.0;
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstring>
+
+// Instruction set used by the SIMD kernels (flat_rects.h, packet.h), detected at
+// startup and selectable with --simd.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PT_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+inline const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::SSE2: return "sse2";
+        default:              return "scalar";
+    }
+}
+
+inline SimdLevel detect_simd_level() {
+#if defined(PT_HAVE_X86_SIMD) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    return SimdLevel::SSE2;  // baseline on x86-64
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+// Nível em uso pelos kernels; main.cpp pode rebaixá-lo com --simd.
+inline SimdLevel& active_simd_level() {
+    static SimdLevel level = detect_simd_level();
+    return level;
+}
+
+// Clamp a requested level to what this CPU supports.
+inline SimdLevel parse_simd_level(const char* name) {
+    SimdLevel best = detect_simd_level();
+    SimdLevel wanted = best;
+    if (std::strcmp(name, "scalar") == 0) wanted = SimdLevel::Scalar;
+    else if (std::strcmp(name, "sse2") == 0 || std::strcmp(name, "sse") == 0) wanted = SimdLevel::SSE2;
+    else if (std::strcmp(name, "avx2") == 0) wanted = SimdLevel::AVX2;
+    return static_cast<int>(wanted) < static_cast<int>(best) ? wanted : best;
+}
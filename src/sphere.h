@@ -1,42 +1,65 @@
 #pragma once
 #include "hittable.h"
 #include "vec3.h"
-#include <memory>
+#include <cmath>
+#include <utility>
 
-class Sphere : public Hittable {
+class Sphere final : public Hittable {
 public:
     Vec3 center;
-    double radius;
-    std::shared_ptr<Material> mat_ptr;
+    Real radius;
+    MaterialId mat_id;
 
     Sphere() {}
-    Sphere(Vec3 cen, double r, std::shared_ptr<Material> m)
-        : center(cen), radius(r), mat_ptr(std::move(m)) {}
+    Sphere(Vec3 cen, Real r, MaterialId m)
+        : center(cen), radius(r), mat_id(m) {}
 
-    virtual bool hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override {
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
+        Real root;
+        if (!nearest_root(r, t_min, t_max, root)) return false;
+        rec.t = root;
+        // Reprojected onto the sphere: the error of root grows with the distance to
+        // the ray origin, the offset of spawned rays assumes a point on the surface
+        Vec3 outward_normal = unit_vector(r.at(rec.t) - center);
+        rec.p = center + radius * outward_normal;
+        rec.set_face_normal(r, outward_normal);
+        rec.mat_id = mat_id;
+        return true;
+    }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        Real root;
+        return nearest_root(r, t_min, t_max, root);
+    }
+
+    virtual AABB bounding_box() const override {
+        Vec3 r(radius, radius, radius);
+        return AABB(center - r, center + r);
+    }
+
+private:
+    // Nearest root of the ray-sphere equation in [t_min, t_max].
+    bool nearest_root(const Ray& r, Real t_min, Real t_max, Real& root) const {
         Vec3 oc = r.origin() - center;
         auto a = r.direction().length_squared();
         auto half_b = dot(oc, r.direction());
         auto c = oc.length_squared() - radius * radius;
-
-        auto discriminant = half_b * half_b - a * c;
+        // half_b^2 - a*c rewritten as a*(r^2 - |oc - (half_b/a) d|^2) and the roots as
+        // c/q and q/a (Ray Tracing Gems, ch. 7): no cancellation when the sphere is
+        // small and far from the origin, which float cannot afford
+        Vec3 l = oc - (half_b / a) * r.direction();
+        auto discriminant = a * (radius * radius - l.length_squared());
         if (discriminant < 0) return false;
-        auto sqrtd = std::sqrt(discriminant);
-
+        auto q = -half_b - std::copysign(std::sqrt(discriminant), half_b);
+        auto t0 = c / q, t1 = q / a;
+        if (t0 > t1) std::swap(t0, t1);
         // Find the nearest root that lies in the acceptable range.
-        auto root = (-half_b - sqrtd) / a;
+        root = t0;
         if (root < t_min || root > t_max) {
-            root = (-half_b + sqrtd) / a;
+            root = t1;
             if (root < t_min || root > t_max)
                 return false;
         }
-
-        rec.t = root;
-        rec.p = r.at(rec.t);
-        Vec3 outward_normal = (rec.p - center) / radius;
-        rec.set_face_normal(r, outward_normal);
-        rec.mat_ptr = mat_ptr;
-
         return true;
     }
-}; 
\ No newline at end of file
+};
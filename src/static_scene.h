@@ -0,0 +1,138 @@
+#pragma once
+#include "bvh.h"
+#include "box.h"
+#include "flat_rects.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "rectangle.h"
+#include "sphere.h"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Statically dispatched geometry (the default; --virtual_scene traces the BVH of
+// Hittable pointers instead). Every primitive of the closed set below is copied
+// by value into the contiguous array of its type, and the BVH is the one BVH
+// builds over the same list, so the images are identical. A leaf entry packs
+// (type, index) and the leaf test is a switch whose branches call the concrete,
+// final types directly: the intersection code inlines into the traversal loop,
+// one instantiation per type, and no shared_ptr is followed. Objects of any other
+// type (extensions) stay behind their pointer and are called virtually.
+class StaticScene final : public Hittable {
+public:
+    enum Kind : uint32_t { RectXY, RectXZ, RectYZ, RectXZDoubleSided, SphereKind, BoxKind, BoxInstance, FlatRects, Other };
+
+    std::vector<XYRect> xy_rects;
+    std::vector<XZRect> xz_rects;
+    std::vector<YZRect> yz_rects;
+    std::vector<DoubleSidedXZRect> double_sided_rects;
+    std::vector<Sphere> spheres;
+    std::vector<Box> boxes;
+    std::vector<TypedInstance<Box>> box_instances;
+    std::vector<FlatRectSet> flat_sets;
+    std::vector<std::shared_ptr<Hittable>> others;
+
+    explicit StaticScene(const HittableList& list, int max_leaf_size = 2) {
+        std::vector<uint32_t> list_refs;
+        list_refs.reserve(list.objects.size());
+        for (const auto& object : list.objects) list_refs.push_back(add(object));
+        BVH bvh(list, max_leaf_size);
+        stats = bvh.build_stats();
+        nodes = bvh.node_array();
+        refs.reserve(list_refs.size());
+        for (uint32_t index : bvh.primitive_order()) refs.push_back(list_refs[index]);
+    }
+
+    // Calls f with the primitive behind a leaf entry, as its concrete type
+    template <typename F>
+    decltype(auto) visit(uint32_t ref, F&& f) const {
+        const uint32_t i = ref & kIndexMask;
+        switch (static_cast<Kind>(ref >> kKindShift)) {
+            case RectXY: return f(xy_rects[i]);
+            case RectXZ: return f(xz_rects[i]);
+            case RectYZ: return f(yz_rects[i]);
+            case RectXZDoubleSided: return f(double_sided_rects[i]);
+            case SphereKind: return f(spheres[i]);
+            case BoxKind: return f(boxes[i]);
+            case BoxInstance: return f(box_instances[i]);
+            case FlatRects: return f(flat_sets[i]);
+            default: return f(static_cast<const Hittable&>(*others[i]));
+        }
+    }
+
+    virtual bool hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const override {
+        return bvh_traverse(nodes.data(), nodes.size(), r, t_min, t_max, rec, [&](int i, Real closest, HitRecord& temp) {
+            return visit(refs[i], [&](const auto& p) { return p.hit(r, t_min, closest, temp); });
+        });
+    }
+
+    virtual bool occluded(const Ray& r, Real t_min, Real t_max) const override {
+        // Rects and flat rect sets take their any-hit tests (the SIMD one for the sets)
+        return bvh_occluded(nodes.data(), nodes.size(), r, t_min, t_max, [&](int i) {
+            return visit(refs[i], [&](const auto& p) { return p.occluded(r, t_min, t_max); });
+        });
+    }
+
+    virtual void hit_packet(const RayPacket& packet, uint64_t active, PacketHits& hits) const override {
+        bvh_traverse_packet(nodes.data(), nodes.size(), packet, active, hits, [&](int i, uint64_t mask) {
+            visit(refs[i], [&](const auto& p) {
+                using P = std::decay_t<decltype(p)>;
+                if constexpr (std::is_same<P, FlatRectSet>::value || std::is_same<P, Hittable>::value) {
+                    p.hit_packet(packet, mask, hits);
+                } else {
+                    // Ray by ray, like Hittable::hit_packet()
+                    HitRecord temp;
+                    for (; mask; mask &= mask - 1) {
+                        int k = __builtin_ctzll(mask);
+                        if (p.hit(packet.ray(k), 0, hits.t[k], temp)) hits.record(k, temp);
+                    }
+                }
+            });
+        });
+    }
+
+    virtual AABB bounding_box() const override {
+        return nodes.empty() ? AABB() : nodes[0].bounds;
+    }
+
+    void print_build_stats(std::ostream& out) const {
+        out << "Static scene: " << refs.size() << " primitives (" << xy_rects.size() + xz_rects.size() + yz_rects.size() +
+                   double_sided_rects.size() << " rects, " << spheres.size() << " spheres, " << boxes.size() << " boxes, "
+            << box_instances.size() << " box instances, " << flat_sets.size() << " flat rect sets, " << others.size()
+            << " virtual), BVH " << stats.nodes << " nodes, depth " << stats.max_depth << ", built in " << stats.build_ms
+            << " ms\n";
+    }
+
+private:
+    static constexpr uint32_t kKindShift = 28;
+    static constexpr uint32_t kIndexMask = (1u << kKindShift) - 1;
+
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> refs;  // (kind << kKindShift) | index, in BVH leaf order
+    BVHBuildStats stats;
+
+    template <typename T>
+    static uint32_t push(std::vector<T>& array, const T& value, Kind kind) {
+        array.push_back(value);
+        return (static_cast<uint32_t>(kind) << kKindShift) | static_cast<uint32_t>(array.size() - 1);
+    }
+
+    uint32_t add(const std::shared_ptr<Hittable>& object) {
+        const Hittable* p = object.get();
+        if (auto r = dynamic_cast<const XYRect*>(p)) return push(xy_rects, *r, RectXY);
+        if (auto r = dynamic_cast<const XZRect*>(p)) return push(xz_rects, *r, RectXZ);
+        if (auto r = dynamic_cast<const YZRect*>(p)) return push(yz_rects, *r, RectYZ);
+        if (auto r = dynamic_cast<const DoubleSidedXZRect*>(p)) return push(double_sided_rects, *r, RectXZDoubleSided);
+        if (auto s = dynamic_cast<const Sphere*>(p)) return push(spheres, *s, SphereKind);
+        if (auto b = dynamic_cast<const Box*>(p)) return push(boxes, *b, BoxKind);
+        if (auto f = dynamic_cast<const FlatRectSet*>(p)) return push(flat_sets, *f, FlatRects);
+        // RotatedBox e outras instâncias de uma Box
+        if (auto inst = dynamic_cast<const Instance*>(p)) {
+            if (auto b = dynamic_cast<const Box*>(inst->object.get()))
+                return push(box_instances, TypedInstance<Box>(*b, inst->transform), BoxInstance);
+        }
+        return push(others, object, Other);
+    }
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Rectangular block of pixels [x0, x1) x [y0, y1), in framebuffer rows (row 0 = top).
+struct Tile {
+    int x0, y0, x1, y1;
+};
+
+inline std::vector<Tile> make_tiles(int width, int height, int tile_size) {
+    std::vector<Tile> tiles;
+    for (int y = 0; y < height; y += tile_size)
+        for (int x = 0; x < width; x += tile_size)
+            tiles.push_back({x, y, std::min(x + tile_size, width), std::min(y + tile_size, height)});
+    return tiles;
+}
+
+inline int resolve_thread_count(int requested) {
+    if (requested > 0) return requested;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? static_cast<int>(hw) : 1;
+}
+
+// Work-stealing scheduler: every worker owns a deque of task indices seeded with a
+// contiguous block of tasks. A worker pops from the front of its own deque and, once
+// it is empty, steals from the back of the other workers' deques. Cheap tiles (empty
+// walls) therefore never leave a thread idle while another is stuck on the expensive ones.
+class WorkStealingScheduler {
+public:
+    explicit WorkStealingScheduler(int num_threads)
+        : queues(std::max(num_threads, 1)) {}
+
+    int num_workers() const { return static_cast<int>(queues.size()); }
+
+    // Runs task(index, worker) for every index in [0, num_tasks). The calling thread
+    // acts as worker 0, so a single-threaded run spawns no threads at all.
+    void run(size_t num_tasks, const std::function<void(size_t, int)>& task) {
+        const size_t workers = queues.size();
+        for (size_t w = 0; w < workers; ++w) {
+            size_t begin = num_tasks * w / workers;
+            size_t end = num_tasks * (w + 1) / workers;
+            queues[w].tasks.clear();
+            for (size_t i = begin; i < end; ++i) queues[w].tasks.push_back(i);
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t w = 1; w < workers; ++w)
+            threads.emplace_back([this, w, &task] { worker_loop(static_cast<int>(w), task); });
+        worker_loop(0, task);
+        for (auto& t : threads) t.join();
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+    std::vector<Queue> queues;
+
+    bool pop_local(int w, size_t& out) {
+        Queue& q = queues[w];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        out = q.tasks.front();
+        q.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(int thief, size_t& out) {
+        const int n = num_workers();
+        for (int k = 1; k < n; ++k) {
+            Queue& q = queues[(thief + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            out = q.tasks.back();
+            q.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    void worker_loop(int w, const std::function<void(size_t, int)>& task) {
+        size_t index;
+        // Tasks are never re-queued, so once every deque is empty there is no more work.
+        while (pop_local(w, index) || steal(w, index))
+            task(index, w);
+    }
+};
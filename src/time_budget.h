@@ -0,0 +1,60 @@
+#pragma once
+#include "path_tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+struct TimeBudgetResult {
+    int samples = 0;        // spp acumuladas em todos os pixels
+    int passes = 0;
+    double seconds = 0.0;   // do início da primeira passada ao fim da última
+};
+
+// Time-budgeted rendering (--time_budget): passes over the whole image, starting
+// at 1 spp and at most doubling, until the next pass would end past the deadline.
+// The pass size comes from the measured time per spp: the larger of the average
+// so far (gaps between passes included) and the last pass, plus a margin. The
+// render stops at a pass boundary, so every pixel has the same number of samples
+// and, the sampler being counter-based, they are the paths --samples with that
+// count traces (the sums differ only by float rounding). The exception is
+// --sampler stratified, whose grid is laid out for settings.samples_per_pixel and
+// not for the count reached. Timing noise aside, only the first pass can overrun:
+// when 1 spp takes longer than the whole budget.
+inline TimeBudgetResult render_time_budget(const Scene& scene, const Camera& cam, const RenderSettings& settings,
+                                           double budget_seconds, Framebuffer& framebuffer, AovBuffers* aovs = nullptr) {
+    static constexpr double kMargin = 1.05;
+
+    framebuffer = Framebuffer(settings.image_width, settings.image_height);
+    if (aovs) *aovs = AovBuffers(settings.image_width, settings.image_height);
+    const double pixels = static_cast<double>(framebuffer.pixel_count());
+    std::cerr << "Rendering for " << budget_seconds << " s on " << resolve_thread_count(settings.num_threads)
+              << " threads\n";
+
+    TimeBudgetResult result;
+    auto start = std::chrono::steady_clock::now();
+    int n = 1;
+    while (true) {
+        double seconds = render_pass(scene, cam, settings, framebuffer, result.samples, n, aovs);
+        result.samples += n;
+        ++result.passes;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const double per_sample = std::max(result.seconds / result.samples, seconds / n) * kMargin;
+        const double left = budget_seconds - result.seconds;
+        const int fit = left > 0.0 ? static_cast<int>(std::min(left / per_sample, 1e9)) : 0;
+        std::cerr << "Pass done: " << result.samples << " spp (" << pixels * n / seconds / 1e6 << " Msamples/s), "
+                  << std::max(left, 0.0) << " s left, ~" << result.samples + fit << " spp at the deadline      \n";
+        if (fit < 1) break;
+        // Até dobrar: a estimativa de tempo por spp se refina antes das passadas grandes
+        n = std::min(fit, result.samples);
+    }
+
+    if (result.seconds > budget_seconds)
+        std::cerr << "Over the " << budget_seconds << " s budget by " << result.seconds - budget_seconds
+                  << (result.passes == 1 ? " s: 1 spp takes longer than the budget\n" : " s\n");
+    if (aovs) aovs->finish(result.samples);
+    std::cerr << "Done in " << result.seconds << " s: " << result.samples << " spp in " << result.passes
+              << " passes.          \n";
+    return result;
+}
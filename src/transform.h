@@ -1,23 +1,126 @@
 #pragma once
 #include "vec3.h"
 #include "ray.h"
+#include "aabb.h"
 #include <cmath>
 
+// Affine map as a 3x4 matrix: the 3x3 linear part plus the translation in the
+// last column, p' = M p + t.
+struct Matrix34 {
+    Real m[3][4];
+
+    static Matrix34 identity() {
+        return {{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}}};
+    }
+
+    Vec3 point(const Vec3& p) const {
+        return Vec3(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                    m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                    m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+    }
+
+    Vec3 vector(const Vec3& v) const {
+        return Vec3(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                    m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                    m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+    }
+
+    // Linear part transposed: applied to normals with the inverse matrix
+    Vec3 transposed_vector(const Vec3& v) const {
+        return Vec3(m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+                    m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+                    m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z);
+    }
+
+    Matrix34 operator*(const Matrix34& o) const {
+        Matrix34 r;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                r.m[i][j] = m[i][0] * o.m[0][j] + m[i][1] * o.m[1][j] + m[i][2] * o.m[2][j];
+                if (j == 3) r.m[i][j] += m[i][3];
+            }
+        }
+        return r;
+    }
+
+    // Inverse via the adjugate of the linear part; the map must be invertible
+    Matrix34 inverse() const {
+        Real a = m[0][0], b = m[0][1], c = m[0][2];
+        Real d = m[1][0], e = m[1][1], f = m[1][2];
+        Real g = m[2][0], h = m[2][1], k = m[2][2];
+        Real A = e * k - f * h, B = f * g - d * k, C = d * h - e * g;
+        Real inv_det = 1 / (a * A + b * B + c * C);
+        Matrix34 r = {{{A * inv_det, (c * h - b * k) * inv_det, (b * f - c * e) * inv_det, 0},
+                       {B * inv_det, (a * k - c * g) * inv_det, (c * d - a * f) * inv_det, 0},
+                       {C * inv_det, (b * g - a * h) * inv_det, (a * e - b * d) * inv_det, 0}}};
+        Vec3 t = r.vector(Vec3(m[0][3], m[1][3], m[2][3]));
+        r.m[0][3] = -t.x;
+        r.m[1][3] = -t.y;
+        r.m[2][3] = -t.z;
+        return r;
+    }
+};
+
+// Object-to-world transform with its inverse, both computed once (cos/sin
+// included) so tracing only does matrix-vector products.
 class Transform {
 public:
-    static Vec3 rotate_y(const Vec3& p, double angle) {
-        double cos_theta = cos(angle);
-        double sin_theta = sin(angle);
-        return Vec3(cos_theta * p.x + sin_theta * p.z,
-                   p.y,
-                   -sin_theta * p.x + cos_theta * p.z);
-    }
-    
-    static Ray rotate_ray_y(const Ray& r, double angle) {
-        return Ray(rotate_y(r.origin(), -angle), rotate_y(r.direction(), -angle));
-    }
-    
-    static Vec3 rotate_normal_y(const Vec3& n, double angle) {
-        return rotate_y(n, angle);
-    }
-}; 
\ No newline at end of file
+    Matrix34 to_world;
+    Matrix34 to_object;
+
+    Transform() : to_world(Matrix34::identity()), to_object(Matrix34::identity()) {}
+    explicit Transform(const Matrix34& m) : to_world(m), to_object(m.inverse()) {}
+
+    static Transform translate(const Vec3& offset) {
+        return Transform({{{1, 0, 0, offset.x}, {0, 1, 0, offset.y}, {0, 0, 1, offset.z}}});
+    }
+
+    static Transform scale(const Vec3& s) {
+        return Transform({{{s.x, 0, 0, 0}, {0, s.y, 0, 0}, {0, 0, s.z, 0}}});
+    }
+
+    // Rotation by `degrees` around the y axis (the RotatedBox convention)
+    static Transform rotate_y(Real degrees) {
+        Real radians = degrees * M_PI / 180.0;
+        Real c = std::cos(radians), s = std::sin(radians);
+        return Transform({{{c, 0, s, 0}, {0, 1, 0, 0}, {-s, 0, c, 0}}});
+    }
+
+    // Rotation by `degrees` around an arbitrary axis (Rodrigues)
+    static Transform rotate(const Vec3& axis, Real degrees) {
+        Vec3 a = unit_vector(axis);
+        Real radians = degrees * M_PI / 180.0;
+        Real c = std::cos(radians), s = std::sin(radians), t = 1 - c;
+        return Transform({{{t * a.x * a.x + c, t * a.x * a.y - s * a.z, t * a.x * a.z + s * a.y, 0},
+                           {t * a.x * a.y + s * a.z, t * a.y * a.y + c, t * a.y * a.z - s * a.x, 0},
+                           {t * a.x * a.z - s * a.y, t * a.y * a.z + s * a.x, t * a.z * a.z + c, 0}}});
+    }
+
+    // `*this` applied after `o`
+    Transform operator*(const Transform& o) const {
+        Transform r;
+        r.to_world = to_world * o.to_world;
+        r.to_object = o.to_object * to_object;
+        return r;
+    }
+
+    // The direction is not normalized, so hit distances are the same in both spaces
+    Ray ray_to_object(const Ray& r) const {
+        return Ray(to_object.point(r.origin()), to_object.vector(r.direction()));
+    }
+
+    Vec3 point_to_world(const Vec3& p) const { return to_world.point(p); }
+
+    // Normals go through the inverse transpose; the caller normalizes
+    Vec3 normal_to_world(const Vec3& n) const { return to_object.transposed_vector(n); }
+
+    AABB box_to_world(const AABB& box) const {
+        AABB result;
+        for (int i = 0; i < 8; ++i) {
+            Vec3 corner((i & 1) ? box.maximum.x : box.minimum.x, (i & 2) ? box.maximum.y : box.minimum.y,
+                        (i & 4) ? box.maximum.z : box.minimum.z);
+            result.expand(to_world.point(corner));
+        }
+        return result;
+    }
+};
@@ -1,113 +1,130 @@
 #pragma once
 #include <cmath>
 #include <iostream>
-#include <cstdlib>
+#include "sampler.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
-class Vec3 {
+// Escalar do núcleo geométrico (Vec3, Ray, HitRecord, primitivas, câmera).
+// cmake -DPT_USE_FLOAT=ON define PT_FLOAT e troca tudo para float.
+#ifdef PT_FLOAT
+using Real = float;
+#else
+using Real = double;
+#endif
+
+template <typename T>
+class Vec3T {
 public:
-    double x, y, z;
+    using Scalar = T;
+
+    T x, y, z;
 
-    Vec3() : x(0), y(0), z(0) {}
-    Vec3(double x_, double y_, double z_) : x(x_), y(y_), z(z_) {}
+    Vec3T() : x(0), y(0), z(0) {}
+    Vec3T(T x_, T y_, T z_) : x(x_), y(y_), z(z_) {}
 
-    Vec3 operator-() const { return Vec3(-x, -y, -z); }
+    Vec3T operator-() const { return Vec3T(-x, -y, -z); }
 
-    Vec3& operator+=(const Vec3& v) {
+    Vec3T& operator+=(const Vec3T& v) {
         x += v.x; y += v.y; z += v.z;
         return *this;
     }
 
-    Vec3& operator*=(const double t) {
+    Vec3T& operator*=(const T t) {
         x *= t; y *= t; z *= t;
         return *this;
     }
 
-    Vec3& operator/=(const double t) {
+    Vec3T& operator/=(const T t) {
         return *this *= 1 / t;
     }
 
-    double length() const { return std::sqrt(length_squared()); }
-    double length_squared() const { return x * x + y * y + z * z; }
-
-    inline static Vec3 random() {
-        return Vec3(random_double(), random_double(), random_double());
-    }
+    T length() const { return std::sqrt(length_squared()); }
+    T length_squared() const { return x * x + y * y + z * z; }
 
-    inline static Vec3 random(double min, double max) {
-        return Vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+    inline static Vec3T random(Sampler& sampler) {
+        return Vec3T(sampler.next_1d(), sampler.next_1d(), sampler.next_1d());
     }
 
-private:
-    static double random_double() {
-        return rand() / (RAND_MAX + 1.0);
-    }
-    static double random_double(double min, double max) {
-        return min + (max - min) * random_double();
+    inline static Vec3T random(Sampler& sampler, double min, double max) {
+        return Vec3T(min + (max - min) * sampler.next_1d(),
+                     min + (max - min) * sampler.next_1d(),
+                     min + (max - min) * sampler.next_1d());
     }
 };
 
-inline std::ostream& operator<<(std::ostream& out, const Vec3& v) {
+using Vec3 = Vec3T<Real>;
+
+// Scalars are taken as Vec3T<T>::Scalar (a non-deduced context), so `2.0 * v`
+// also works for float vectors.
+template <typename T>
+inline std::ostream& operator<<(std::ostream& out, const Vec3T<T>& v) {
     return out << v.x << ' ' << v.y << ' ' << v.z;
 }
 
-inline Vec3 operator+(const Vec3& u, const Vec3& v) {
-    return Vec3(u.x + v.x, u.y + v.y, u.z + v.z);
+template <typename T>
+inline Vec3T<T> operator+(const Vec3T<T>& u, const Vec3T<T>& v) {
+    return Vec3T<T>(u.x + v.x, u.y + v.y, u.z + v.z);
 }
 
-inline Vec3 operator-(const Vec3& u, const Vec3& v) {
-    return Vec3(u.x - v.x, u.y - v.y, u.z - v.z);
+template <typename T>
+inline Vec3T<T> operator-(const Vec3T<T>& u, const Vec3T<T>& v) {
+    return Vec3T<T>(u.x - v.x, u.y - v.y, u.z - v.z);
 }
 
-inline Vec3 operator*(const Vec3& u, const Vec3& v) {
-    return Vec3(u.x * v.x, u.y * v.y, u.z * v.z);
+template <typename T>
+inline Vec3T<T> operator*(const Vec3T<T>& u, const Vec3T<T>& v) {
+    return Vec3T<T>(u.x * v.x, u.y * v.y, u.z * v.z);
 }
 
-inline Vec3 operator*(double t, const Vec3& v) {
-    return Vec3(t * v.x, t * v.y, t * v.z);
+template <typename T>
+inline Vec3T<T> operator*(typename Vec3T<T>::Scalar t, const Vec3T<T>& v) {
+    return Vec3T<T>(t * v.x, t * v.y, t * v.z);
 }
 
-inline Vec3 operator*(const Vec3& v, double t) {
+template <typename T>
+inline Vec3T<T> operator*(const Vec3T<T>& v, typename Vec3T<T>::Scalar t) {
     return t * v;
 }
 
-inline Vec3 operator/(Vec3 v, double t) {
+template <typename T>
+inline Vec3T<T> operator/(Vec3T<T> v, typename Vec3T<T>::Scalar t) {
     return (1 / t) * v;
 }
 
-inline double dot(const Vec3& u, const Vec3& v) {
+template <typename T>
+inline T dot(const Vec3T<T>& u, const Vec3T<T>& v) {
     return u.x * v.x + u.y * v.y + u.z * v.z;
 }
 
-inline Vec3 cross(const Vec3& u, const Vec3& v) {
-    return Vec3(u.y * v.z - u.z * v.y,
-                u.z * v.x - u.x * v.z,
-                u.x * v.y - u.y * v.x);
+template <typename T>
+inline Vec3T<T> cross(const Vec3T<T>& u, const Vec3T<T>& v) {
+    return Vec3T<T>(u.y * v.z - u.z * v.y,
+                    u.z * v.x - u.x * v.z,
+                    u.x * v.y - u.y * v.x);
 }
 
-inline Vec3 unit_vector(Vec3 v) {
+template <typename T>
+inline Vec3T<T> unit_vector(Vec3T<T> v) {
     return v / v.length();
 }
 
-inline Vec3 random_in_unit_sphere() {
+inline Vec3 random_in_unit_sphere(Sampler& sampler) {
     while (true) {
-        Vec3 p = Vec3::random(-1, 1);
+        Vec3 p = Vec3::random(sampler, -1, 1);
         if (p.length_squared() >= 1) continue;
         return p;
     }
 }
 
-inline Vec3 random_unit_vector() {
-    return unit_vector(random_in_unit_sphere());
+inline Vec3 random_unit_vector(Sampler& sampler) {
+    return unit_vector(random_in_unit_sphere(sampler));
 } 
 
 // Cosine-weighted hemisphere sampling for better diffuse lighting
-inline Vec3 random_cosine_direction() {
-    auto r1 = (double) rand() / RAND_MAX;
-    auto r2 = (double) rand() / RAND_MAX;
+inline Vec3 cosine_direction(double r1, double r2) {
     auto z = std::sqrt(1 - r2);
     
     auto phi = 2 * M_PI * r1;
@@ -117,10 +134,16 @@ inline Vec3 random_cosine_direction() {
     return Vec3(x, y, z);
 }
 
+inline Vec3 random_cosine_direction(Sampler& sampler) {
+    auto r1 = sampler.next_1d();
+    auto r2 = sampler.next_1d();
+    return cosine_direction(r1, r2);
+}
+
 // Helper to create orthonormal basis from a normal
 inline void onb_from_w(const Vec3& n, Vec3& u, Vec3& v, Vec3& w) {
     w = unit_vector(n);
     Vec3 a = (std::abs(w.x) > 0.9) ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
     v = unit_vector(cross(w, a));
     u = cross(w, v);
-} 
\ No newline at end of file
+} 
@@ -0,0 +1,238 @@
+#pragma once
+#include "scene.h"
+#include "camera.h"
+#include "light_sampling.h"
+#include "render_settings.h"
+#include "tile_scheduler.h"
+#include "sampler.h"
+#include "image.h"
+#include "render_stats.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Wavefront path tracing: instead of following one path at a time through the
+// recursive ray_color(), a whole batch of paths is kept in structure-of-arrays
+// buffers and advanced one stage at a time:
+//
+//   generate -> [extend -> shade -> shadow -> resolve]* -> accumulate
+//
+// Each stage runs over the whole queue of live paths, so the intersection loop and
+// the shading loop each stay hot in the instruction cache and operate on
+// contiguous data. The estimator is the same as ray_color() (same sampler
+// dimensions, same MIS weights and Russian roulette), only the evaluation order
+// changes.
+class WavefrontIntegrator {
+public:
+    // Upper bound on paths in flight per batch (per worker).
+    static constexpr size_t kMaxBatch = 1 << 15;
+
+    WavefrontIntegrator(const Scene& scene, const Camera& cam, const RenderSettings& settings)
+        : scene(scene), cam(cam), settings(settings) {}
+
+    // Traces samples [first_sample, first_sample + num_samples) of every pixel in
+    // `tile` and adds the per-pixel radiance sums to `framebuffer`.
+    void render_tile(const Tile& tile, Framebuffer& framebuffer, int first_sample, int num_samples) {
+        const int tile_width = tile.x1 - tile.x0;
+        const size_t spp = static_cast<size_t>(std::max(num_samples, 0));
+        const size_t total = static_cast<size_t>(tile_width) * (tile.y1 - tile.y0) * spp;
+
+        for (size_t begin = 0; begin < total; begin += kMaxBatch) {
+            size_t count = std::min(kMaxBatch, total - begin);
+            paths.resize(count);
+
+            generate(tile, begin, count, spp, first_sample);
+            while (!active.empty()) {
+                extend();
+                shade();
+                trace_shadow_rays();
+                resolve();
+            }
+            accumulate(framebuffer, count);
+        }
+    }
+
+private:
+    const Scene& scene;
+    const Camera& cam;
+    const RenderSettings& settings;
+
+    // Estado dos caminhos em SoA; o índice k identifica o caminho dentro do lote.
+    struct PathBuffers {
+        std::vector<Vec3> origin, direction;
+        std::vector<Vec3> throughput, radiance;
+        std::vector<size_t> pixel;
+        std::vector<int> depth, min_depth;
+        std::vector<Sampler> sampler;
+        std::vector<HitRecord> hit;
+        // Written by shade, consumed by shadow/resolve
+        std::vector<Vec3> attenuation;
+        std::vector<double> pdf_brdf;          // pdf of the BSDF sample that made the current ray
+        std::vector<LightSampleQuery> light;
+        std::vector<Vec3> direct;              // light sample contribution if unoccluded
+        std::vector<uint8_t> light_visible;
+        PT_STAT(std::vector<double> light_weight;)
+
+        void resize(size_t n) {
+            origin.resize(n); direction.resize(n);
+            throughput.resize(n); radiance.resize(n);
+            pixel.resize(n); depth.resize(n); min_depth.resize(n);
+            sampler.resize(n); hit.resize(n);
+            attenuation.resize(n); pdf_brdf.resize(n);
+            light.resize(n); direct.resize(n); light_visible.resize(n);
+            PT_STAT(light_weight.resize(n));
+        }
+    };
+
+    PathBuffers paths;
+    std::vector<uint32_t> active;        // paths that need an extension ray
+    std::vector<uint32_t> shade_queue;   // paths whose extension ray hit something
+    std::vector<uint32_t> shadow_queue;  // paths with a light sample to test
+    std::vector<uint32_t> resolve_queue; // paths that continue after this bounce
+
+    void generate(const Tile& tile, size_t begin, size_t count, size_t spp, int first_sample) {
+        const int tile_width = tile.x1 - tile.x0;
+        active.clear();
+        for (size_t k = 0; k < count; ++k) {
+            size_t id = begin + k;
+            int s = first_sample + static_cast<int>(id % spp);
+            size_t p = id / spp;
+            int i = tile.x0 + static_cast<int>(p % tile_width);
+            int row = tile.y0 + static_cast<int>(p / tile_width);
+            int j = settings.image_height - 1 - row;
+
+            Sampler& sampler = paths.sampler[k];
+            sampler = Sampler(settings.seed, settings.sampler, settings.samples_per_pixel);
+            sampler.start_sample(i, j, s);
+            Ray r = jittered_camera_ray(cam, i, j, settings.image_width, settings.image_height, sampler);
+
+            paths.origin[k] = r.orig;
+            paths.direction[k] = r.dir;
+            paths.throughput[k] = Vec3(1, 1, 1);
+            paths.radiance[k] = Vec3(0, 0, 0);
+            paths.pixel[k] = static_cast<size_t>(row) * settings.image_width + i;
+            paths.depth[k] = settings.max_depth;
+            paths.min_depth[k] = settings.min_depth;
+            paths.pdf_brdf[k] = 0.0;
+            active.push_back(static_cast<uint32_t>(k));
+        }
+    }
+
+    // Closest-hit query for every live path; misses terminate (black background).
+    void extend() {
+        shade_queue.clear();
+        const Hittable& world = scene.world();
+        for (uint32_t k : active) {
+            if (paths.depth[k] <= 0) {
+                PT_STAT(render_stats::local().end_path(paths.sampler[k].current_bounce()));
+                continue;
+            }
+            paths.sampler[k].next_bounce();
+            PT_STAT(++(paths.sampler[k].current_bounce() == 1 ? render_stats::local().camera_rays
+                                                               : render_stats::local().extension_rays));
+            Ray r(paths.origin[k], paths.direction[k]);
+            bool hit;
+            {
+                PT_STAT(render_stats::IntersectTimer timer);
+                hit = world.hit(r, 0, std::numeric_limits<Real>::infinity(), paths.hit[k]);
+            }
+            if (hit) {
+                shade_queue.push_back(k);
+            } else {
+                PT_STAT(render_stats::local().end_path(paths.sampler[k].current_bounce()));
+            }
+        }
+    }
+
+    // Emission, BSDF sampling, Russian roulette and light sample generation.
+    void shade() {
+        shadow_queue.clear();
+        resolve_queue.clear();
+        for (uint32_t k : shade_queue)
+            scene.materials.visit(paths.hit[k].mat_id, [&](const auto& mat) { shade_path(k, mat); });
+    }
+
+    // shade() for path k, with its hit's material as its static type M
+    template <typename M>
+    void shade_path(uint32_t k, const M& mat) {
+        const bool use_mis = settings.use_mis;
+        const HitRecord& rec = paths.hit[k];
+        Sampler& sampler = paths.sampler[k];
+        Vec3& beta = paths.throughput[k];
+
+        if (mat.is_emissive()) {
+            PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
+            double w = 1.0;
+            if (use_mis && paths.pdf_brdf[k] > 0.0) {
+                w = power_heuristic(paths.pdf_brdf[k], scene.lights.pdf(paths.origin[k], rec));
+                PT_STAT(render_stats::Counters::add_weight(render_stats::local().brdf_weight, w));
+            }
+            paths.radiance[k] += beta * (mat.emitted() * w);
+            return;
+        }
+
+        Ray in(paths.origin[k], paths.direction[k]);
+        Ray scattered;
+        Vec3 attenuation;
+        if (!mat.scatter(in, rec, attenuation, scattered, sampler)) {
+            PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
+            return;
+        }
+
+        double rr_scale = 1.0;
+        if (paths.min_depth[k] <= 0) {
+            double max_component = std::max(attenuation.x, std::max(attenuation.y, attenuation.z));
+            double survival_prob = std::min(max_component, 0.95);
+            if (sampler.next_1d() > survival_prob) {
+                PT_STAT(++render_stats::local().rr_terminations);
+                PT_STAT(render_stats::local().end_path(sampler.current_bounce()));
+                return;
+            }
+            attenuation = attenuation / survival_prob;
+            rr_scale = 1.0 / survival_prob;
+        }
+
+        paths.light_visible[k] = 0;
+        if (use_mis) {
+            const LightSampleQuery& light = paths.light[k] = prepare_light_sample(rec.p, rec.normal, scene, sampler);
+            if (light.valid) {
+                const LightSample& ls = light.unoccluded;
+                double w_light = power_heuristic(ls.pdf, mat.scatter_pdf(rec, ls.dir));
+                paths.direct[k] = beta * (mat.eval(rec, ls.dir) * ls.Li * (w_light * rr_scale));
+                PT_STAT(paths.light_weight[k] = w_light);
+                shadow_queue.push_back(k);
+            }
+        }
+
+        paths.pdf_brdf[k] = mat.scatter_pdf(rec, unit_vector(scattered.direction()));
+        paths.attenuation[k] = attenuation;
+        paths.origin[k] = scattered.orig;
+        paths.direction[k] = scattered.dir;
+        resolve_queue.push_back(k);
+    }
+
+    void trace_shadow_rays() {
+        for (uint32_t k : shadow_queue)
+            paths.light_visible[k] = light_visible(paths.light[k], scene) ? 1 : 0;
+    }
+
+    // Direct light contribution and throughput update.
+    void resolve() {
+        for (uint32_t k : resolve_queue) {
+            if (paths.light_visible[k]) {
+                paths.radiance[k] += paths.direct[k];
+                PT_STAT(render_stats::Counters::add_weight(render_stats::local().light_weight, paths.light_weight[k]));
+            }
+            paths.throughput[k] = paths.throughput[k] * paths.attenuation[k];
+            --paths.depth[k];
+            --paths.min_depth[k];
+        }
+        active.swap(resolve_queue);
+    }
+
+    void accumulate(Framebuffer& framebuffer, size_t count) {
+        for (size_t k = 0; k < count; ++k)
+            framebuffer.add(paths.pixel[k], paths.radiance[k]);
+    }
+};